@@ -0,0 +1,530 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Trace-driven benchmark of every cache mode.
+ * Build with `make bench` (-O2, no sanitizers, logs off), then e.g.
+ *   ./cm_bench                            all workloads, modes and sizes, CSV
+ *   ./cm_bench -w zipf -s 1.1 -f json     one workload as JSON
+ *   ./cm_bench -t ids.txt -c 128,1024     replay a trace, one id per line
+ *   ./cm_bench -a pool -m LRU             recycled payloads from cm_pool
+ * Run ./cm_bench -h for every option. */
+
+#include "cache_manager/cache_manager.h"
+#include "cache_manager/cache_manager_pool.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
+#define BENCH_LIST_MAX 16
+
+typedef enum {
+    WORKLOAD_UNIFORM,
+    WORKLOAD_ZIPF,
+    WORKLOAD_SCAN,
+    WORKLOAD_LOOP,
+    WORKLOAD_MIXED,
+    WORKLOAD_TRACE,
+    _WORKLOAD_LAST
+} workload_t;
+
+/*Payloads of the runs: none, or recycled buffers from malloc or cm_pool*/
+typedef enum {
+    ALLOC_NONE,
+    ALLOC_MALLOC,
+    ALLOC_POOL,
+    _ALLOC_LAST
+} alloc_t;
+
+typedef struct {
+    workload_t workload_array[_WORKLOAD_LAST];
+    uint32_t workload_num;
+    cache_manager_mode_t mode_array[_CACHE_MANAGER_MODE_LAST];
+    uint32_t mode_num;
+    uint32_t cache_num_array[BENCH_LIST_MAX];
+    uint32_t cache_num_num;
+    uint32_t op_num;
+    uint32_t key_num;
+    double skew;
+    const char* trace_path;
+    alloc_t alloc;
+    bool json;
+} bench_config_t;
+
+typedef struct {
+    double ops_per_sec;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double hit_rate;
+    uint64_t create_cnt;
+} bench_result_t;
+
+static const char* workload_name_array[] = { "uniform", "zipf", "scan", "loop", "mixed", "trace" };
+static const char* mode_name_array[] = { "LIFE", "FIFO", "LFU", "LRU", "RANDOM", "GDSF", "ARC", "WTINYLFU", "CLOCK" };
+static const char* alloc_name_array[] = { "none", "malloc", "pool" };
+
+#define PAYLOAD_SIZE_MAX 4096
+
+static uint64_t create_cnt;
+static alloc_t payload_alloc;
+static cache_manager_pool_t* payload_pool;
+
+static uint32_t get_payload_size(int id)
+{
+    /*16 bytes to PAYLOAD_SIZE_MAX, so that recycled buffers don't always fit*/
+    return 16u << ((uint32_t)id % 9);
+}
+
+static void* payload_malloc(uint32_t size)
+{
+    return payload_alloc == ALLOC_POOL ? cm_pool_malloc(payload_pool, size) : malloc(size);
+}
+
+static void payload_free(void* ptr)
+{
+    if (payload_alloc == ALLOC_POOL) {
+        cm_pool_free(payload_pool, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+static bool create_cb(cache_manager_node_t* node)
+{
+    create_cnt++;
+
+    if (payload_alloc == ALLOC_NONE) {
+        node->context.size = 1;
+        return true;
+    }
+
+    /*Recycle mode presets the victim's buffer, keep it when the payload fits*/
+    uint32_t size = get_payload_size(node->id);
+    void* ptr = node->context.ptr;
+    uint32_t capacity = node->context.size;
+
+    if (ptr && payload_alloc == ALLOC_POOL) {
+        capacity = cm_pool_get_block_size(payload_pool, ptr);
+    }
+
+    if (!ptr || capacity < size) {
+        payload_free(ptr);
+        ptr = payload_malloc(size);
+
+        if (!ptr) {
+            node->context.ptr = NULL;
+            return false;
+        }
+    }
+
+    memset(ptr, (uint8_t)node->id, size);
+    node->context.ptr = ptr;
+    node->context.size = size;
+    return true;
+}
+
+static bool delete_cb(cache_manager_node_t* node)
+{
+    if (payload_alloc != ALLOC_NONE) {
+        payload_free(node->context.ptr);
+    }
+
+    return true;
+}
+
+static uint64_t get_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t tick_get(void)
+{
+    return (uint32_t)(get_time_ns() / 1000);
+}
+
+static uint32_t rand_u32(uint64_t* state)
+{
+    /*xorshift64*, so that every run replays the same ids*/
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (uint32_t)((*state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static double rand_unit(uint64_t* state)
+{
+    return (double)rand_u32(state) / 4294967296.0;
+}
+
+static void gen_zipf(int* id_array, uint32_t op_num, uint32_t key_num, double skew, uint64_t* state)
+{
+    double* cdf = malloc(sizeof(double) * key_num);
+    double sum = 0;
+
+    for (uint32_t i = 0; i < key_num; i++) {
+        sum += 1.0 / pow(i + 1, skew);
+        cdf[i] = sum;
+    }
+
+    for (uint32_t i = 0; i < op_num; i++) {
+        double r = rand_unit(state) * sum;
+        uint32_t lo = 0, hi = key_num - 1;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (cdf[mid] < r) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        /*Scatter the popular ids so that they don't sit next to each other*/
+        id_array[i] = (int)((lo * 2654435761u) % key_num) + 1;
+    }
+
+    free(cdf);
+}
+
+static int* load_trace(const char* path, uint32_t* op_num)
+{
+    FILE* fp = fopen(path, "r");
+
+    if (!fp) {
+        fprintf(stderr, "can't open trace %s\n", path);
+        return NULL;
+    }
+
+    uint32_t cap = 1024, num = 0;
+    int* id_array = malloc(sizeof(int) * cap);
+    long id;
+
+    while (fscanf(fp, "%ld", &id) == 1) {
+        if (num == cap) {
+            cap *= 2;
+            id_array = realloc(id_array, sizeof(int) * cap);
+        }
+        /*0 is CACHE_MANAGER_INVALIDATE_ID, shift every id by one*/
+        id_array[num++] = (int)id + 1;
+    }
+
+    fclose(fp);
+    *op_num = num;
+    return id_array;
+}
+
+static int* gen_workload(const bench_config_t* config, workload_t workload, uint32_t* op_num)
+{
+    if (workload == WORKLOAD_TRACE) {
+        return load_trace(config->trace_path, op_num);
+    }
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    uint32_t key_num = config->key_num;
+    int* id_array = malloc(sizeof(int) * config->op_num);
+    *op_num = config->op_num;
+
+    switch (workload) {
+    case WORKLOAD_UNIFORM:
+        for (uint32_t i = 0; i < *op_num; i++) {
+            id_array[i] = (int)(rand_u32(&state) % key_num) + 1;
+        }
+        break;
+
+    case WORKLOAD_ZIPF:
+        gen_zipf(id_array, *op_num, key_num, config->skew, &state);
+        break;
+
+    case WORKLOAD_SCAN:
+        /*Every id once, the worst case for recency*/
+        for (uint32_t i = 0; i < *op_num; i++) {
+            id_array[i] = (int)(i % 0x7FFFFFFE) + 1;
+        }
+        break;
+
+    case WORKLOAD_LOOP:
+        for (uint32_t i = 0; i < *op_num; i++) {
+            id_array[i] = (int)(i % key_num) + 1;
+        }
+        break;
+
+    case WORKLOAD_MIXED:
+        /*A Zipf hot set with bursts of one-shot ids*/
+        gen_zipf(id_array, *op_num, key_num, config->skew, &state);
+        for (uint32_t i = 0; i < *op_num; i++) {
+            if ((i / 100) % 4 == 3) {
+                id_array[i] = (int)(key_num + i % 0x3FFFFFFF) + 1;
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return id_array;
+}
+
+static int cmp_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static bool run_bench(cache_manager_mode_t mode, uint32_t cache_num, const int* id_array, uint32_t op_num, uint64_t* lat_array, bench_result_t* result)
+{
+    if (payload_alloc == ALLOC_POOL) {
+        payload_pool = cm_pool_create(PAYLOAD_SIZE_MAX, 64 * 1024);
+
+        if (!payload_pool) {
+            return false;
+        }
+    }
+
+    cache_manager_t* cm = cm_create(cache_num, mode, create_cb, delete_cb, tick_get, NULL);
+
+    if (!cm) {
+        if (payload_pool) {
+            cm_pool_delete(payload_pool);
+            payload_pool = NULL;
+        }
+        return false;
+    }
+
+    cm_set_recycle(cm, payload_alloc != ALLOC_NONE);
+
+    create_cnt = 0;
+    uint64_t hit_cnt = 0;
+    uint64_t start = get_time_ns();
+
+    for (uint32_t i = 0; i < op_num; i++) {
+        cache_manager_node_t* node;
+        uint64_t op_start = get_time_ns();
+        uint64_t create_before = create_cnt;
+        cm_open(cm, id_array[i], &node);
+        lat_array[i] = get_time_ns() - op_start;
+        hit_cnt += create_cnt == create_before;
+    }
+
+    uint64_t elapsed = get_time_ns() - start;
+    cm_delete(cm);
+
+    if (payload_pool) {
+        cm_pool_delete(payload_pool);
+        payload_pool = NULL;
+    }
+
+    qsort(lat_array, op_num, sizeof(uint64_t), cmp_u64);
+
+    result->ops_per_sec = elapsed ? (double)op_num * 1e9 / (double)elapsed : 0;
+    result->p50_ns = (double)lat_array[(uint64_t)op_num * 500 / 1000];
+    result->p99_ns = (double)lat_array[(uint64_t)op_num * 990 / 1000];
+    result->p999_ns = (double)lat_array[(uint64_t)op_num * 999 / 1000];
+    result->hit_rate = (double)hit_cnt / op_num;
+    result->create_cnt = create_cnt;
+    return true;
+}
+
+static void print_result(const bench_config_t* config, bool first, workload_t workload, cache_manager_mode_t mode, uint32_t cache_num, const bench_result_t* result)
+{
+    if (config->json) {
+        printf("%s\n  {\"workload\": \"%s\", \"mode\": \"%s\", \"cache_num\": %u, \"ops_per_sec\": %.0f, "
+               "\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, \"hit_rate\": %.4f, \"create_cnt\": %llu, \"alloc\": \"%s\"}",
+            first ? "" : ",", workload_name_array[workload], mode_name_array[mode], cache_num, result->ops_per_sec,
+            result->p50_ns, result->p99_ns, result->p999_ns, result->hit_rate, (unsigned long long)result->create_cnt,
+            alloc_name_array[config->alloc]);
+        return;
+    }
+
+    printf("%s,%s,%u,%.0f,%.0f,%.0f,%.0f,%.4f,%llu,%s\n",
+        workload_name_array[workload], mode_name_array[mode], cache_num, result->ops_per_sec,
+        result->p50_ns, result->p99_ns, result->p999_ns, result->hit_rate, (unsigned long long)result->create_cnt,
+        alloc_name_array[config->alloc]);
+}
+
+static uint32_t parse_list(const char* str, const char* const* name_array, uint32_t name_num, uint32_t* out_array, uint32_t out_max)
+{
+    char buf[256];
+    uint32_t num = 0;
+
+    snprintf(buf, sizeof(buf), "%s", str);
+
+    for (char* tok = strtok(buf, ","); tok && num < out_max; tok = strtok(NULL, ",")) {
+        if (!name_array) {
+            out_array[num++] = (uint32_t)strtoul(tok, NULL, 0);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < name_num; i++) {
+            if (strcasecmp(tok, name_array[i]) == 0) {
+                out_array[num++] = i;
+                break;
+            }
+        }
+    }
+
+    return num;
+}
+
+static void print_usage(const char* name)
+{
+    printf("usage: %s [options]\n"
+           "  -w list   workloads: uniform,zipf,scan,loop,mixed (default: all)\n"
+           "  -t path   replay a trace file of ids, one per line\n"
+           "  -m list   modes, e.g. LRU,ARC (default: all)\n"
+           "  -c list   cache_num values (default: 64,256,1024)\n"
+           "  -n num    operations per run (default: 1000000)\n"
+           "  -k num    key space of synthetic workloads (default: 10000)\n"
+           "  -s skew   Zipf skew (default: 0.99)\n"
+           "  -a alloc  payloads: none, or recycled from malloc or pool (default: none)\n"
+           "  -f fmt    csv or json (default: csv)\n",
+        name);
+}
+
+int main(int argc, char* argv[])
+{
+    bench_config_t config = { 0 };
+    uint32_t list[BENCH_LIST_MAX];
+
+    config.op_num = 1000000;
+    config.key_num = 10000;
+    config.skew = 0.99;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || !val) {
+            print_usage(argv[0]);
+            return strcmp(arg, "-h") == 0 ? 0 : 1;
+        }
+
+        i++;
+
+        if (strcmp(arg, "-w") == 0) {
+            config.workload_num = parse_list(val, workload_name_array, WORKLOAD_TRACE, list, BENCH_LIST_MAX);
+            for (uint32_t j = 0; j < config.workload_num; j++) {
+                config.workload_array[j] = (workload_t)list[j];
+            }
+        } else if (strcmp(arg, "-t") == 0) {
+            config.trace_path = val;
+        } else if (strcmp(arg, "-m") == 0) {
+            config.mode_num = parse_list(val, mode_name_array, ARRAY_SIZE(mode_name_array), list, BENCH_LIST_MAX);
+            for (uint32_t j = 0; j < config.mode_num; j++) {
+                config.mode_array[j] = (cache_manager_mode_t)list[j];
+            }
+        } else if (strcmp(arg, "-c") == 0) {
+            config.cache_num_num = parse_list(val, NULL, 0, config.cache_num_array, BENCH_LIST_MAX);
+        } else if (strcmp(arg, "-n") == 0) {
+            config.op_num = (uint32_t)strtoul(val, NULL, 0);
+        } else if (strcmp(arg, "-k") == 0) {
+            config.key_num = (uint32_t)strtoul(val, NULL, 0);
+        } else if (strcmp(arg, "-s") == 0) {
+            config.skew = strtod(val, NULL);
+        } else if (strcmp(arg, "-a") == 0) {
+            uint32_t alloc;
+            if (parse_list(val, alloc_name_array, _ALLOC_LAST, &alloc, 1) == 1) {
+                config.alloc = (alloc_t)alloc;
+            }
+        } else if (strcmp(arg, "-f") == 0) {
+            config.json = strcmp(val, "json") == 0;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (config.trace_path) {
+        config.workload_array[config.workload_num++] = WORKLOAD_TRACE;
+    } else if (config.workload_num == 0) {
+        for (uint32_t i = 0; i < WORKLOAD_TRACE; i++) {
+            config.workload_array[config.workload_num++] = (workload_t)i;
+        }
+    }
+
+    if (config.mode_num == 0) {
+        for (uint32_t i = 0; i < ARRAY_SIZE(mode_name_array); i++) {
+            config.mode_array[config.mode_num++] = (cache_manager_mode_t)i;
+        }
+    }
+
+    if (config.cache_num_num == 0) {
+        config.cache_num_array[config.cache_num_num++] = 64;
+        config.cache_num_array[config.cache_num_num++] = 256;
+        config.cache_num_array[config.cache_num_num++] = 1024;
+    }
+
+    payload_alloc = config.alloc;
+
+    if (config.op_num == 0 || config.key_num == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (config.json) {
+        printf("[");
+    } else {
+        printf("workload,mode,cache_num,ops_per_sec,p50_ns,p99_ns,p999_ns,hit_rate,create_cnt,alloc\n");
+    }
+
+    bool first = true;
+
+    for (uint32_t w = 0; w < config.workload_num; w++) {
+        uint32_t op_num = 0;
+        int* id_array = gen_workload(&config, config.workload_array[w], &op_num);
+
+        if (!id_array || op_num == 0) {
+            free(id_array);
+            continue;
+        }
+
+        uint64_t* lat_array = malloc(sizeof(uint64_t) * op_num);
+
+        for (uint32_t m = 0; m < config.mode_num; m++) {
+            for (uint32_t c = 0; c < config.cache_num_num; c++) {
+                bench_result_t result;
+
+                if (!run_bench(config.mode_array[m], config.cache_num_array[c], id_array, op_num, lat_array, &result)) {
+                    continue;
+                }
+
+                print_result(&config, first, config.workload_array[w], config.mode_array[m], config.cache_num_array[c], &result);
+                first = false;
+                fflush(stdout);
+            }
+        }
+
+        free(lat_array);
+        free(id_array);
+    }
+
+    if (config.json) {
+        printf("\n]\n");
+    }
+
+    return 0;
+}
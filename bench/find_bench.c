@@ -0,0 +1,97 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Micro-benchmark of the id search: the node array scan that cm_find_node()
+ * used without the hash index, against cm_simd_find_id() over packed ids.
+ * Build with `make bench_find`. */
+
+#include "cache_manager/cache_manager.h"
+#include "cache_manager/cache_manager_simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LOOKUP_NUM 2000000
+
+static double get_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static uint32_t find_node_scan(const cache_manager_node_t* node_array, uint32_t num, int id)
+{
+    for (uint32_t i = 0; i < num; i++) {
+        if (node_array[i].id == id) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+int main(void)
+{
+    static const uint32_t num_array[] = { 16, 64, 256, 1024, 4096 };
+
+    printf("num,scan_ns,simd_ns,speedup\n");
+
+    for (uint32_t n = 0; n < sizeof(num_array) / sizeof(num_array[0]); n++) {
+        uint32_t num = num_array[n];
+        cache_manager_node_t* node_array = calloc(num, sizeof(cache_manager_node_t));
+        int* id_array = calloc(num, sizeof(int));
+        int* key_array = malloc(sizeof(int) * LOOKUP_NUM);
+
+        for (uint32_t i = 0; i < num; i++) {
+            node_array[i].id = id_array[i] = (int)(i * 7 + 1);
+        }
+
+        /*Half of the lookups miss and scan the whole array*/
+        srand(1);
+        for (uint32_t i = 0; i < LOOKUP_NUM; i++) {
+            key_array[i] = (rand() % 2) ? (int)((rand() % num) * 7 + 1) : -1 - rand() % 1000;
+        }
+
+        volatile uint32_t sink = 0;
+
+        double start = get_time_ns();
+        for (uint32_t i = 0; i < LOOKUP_NUM; i++) {
+            sink += find_node_scan(node_array, num, key_array[i]);
+        }
+        double scan_ns = (get_time_ns() - start) / LOOKUP_NUM;
+
+        start = get_time_ns();
+        for (uint32_t i = 0; i < LOOKUP_NUM; i++) {
+            sink += cm_simd_find_id(id_array, num, key_array[i]);
+        }
+        double simd_ns = (get_time_ns() - start) / LOOKUP_NUM;
+
+        printf("%u,%.1f,%.1f,%.2f\n", num, scan_ns, simd_ns, scan_ns / simd_ns);
+
+        free(node_array);
+        free(id_array);
+        free(key_array);
+    }
+
+    return 0;
+}
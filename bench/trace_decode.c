@@ -0,0 +1,181 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* Offline decoder of the files written by cm_trace_save().
+ * Build with `make trace_decode`, then e.g.
+ *   ./trace_decode trace.bin              one event per line
+ *   ./trace_decode -s trace.bin           counts and latency per source
+ *   ./trace_decode -i trace.bin > ids.txt accessed ids, for cm_bench -t
+ * Run ./trace_decode -h for every option. */
+
+#include "cache_manager/cache_manager_trace.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCE_NUM_MAX 65536
+
+typedef struct {
+    uint64_t cnt_array[_CACHE_MANAGER_TRACE_LAST];
+    uint64_t create_time_sum;
+    uint32_t create_time_max;
+} source_summary_t;
+
+static void print_usage(const char* name)
+{
+    printf("usage: %s [-s | -i] file\n"
+           "  -s   summary per source: event counts, hit rate, create latency\n"
+           "  -i   ids of hits and misses only, one per line\n",
+        name);
+}
+
+static void print_events(const cache_manager_trace_event_t* event_array, uint32_t num)
+{
+    printf("tick,source,type,id,value\n");
+
+    for (uint32_t i = 0; i < num; i++) {
+        const cache_manager_trace_event_t* event = &event_array[i];
+        printf("%" PRIu32 ",%u,%s,%" PRId32 ",%" PRIu32 "\n",
+            event->tick,
+            (unsigned)event->source,
+            cm_trace_get_type_name((cache_manager_trace_type_t)event->type),
+            event->id,
+            event->value);
+    }
+}
+
+static void print_ids(const cache_manager_trace_event_t* event_array, uint32_t num)
+{
+    for (uint32_t i = 0; i < num; i++) {
+        if (event_array[i].type == CACHE_MANAGER_TRACE_HIT || event_array[i].type == CACHE_MANAGER_TRACE_MISS) {
+            printf("%" PRId32 "\n", event_array[i].id);
+        }
+    }
+}
+
+static bool print_summary(const cache_manager_trace_event_t* event_array, uint32_t num)
+{
+    source_summary_t* summary_array = calloc(SOURCE_NUM_MAX, sizeof(source_summary_t));
+
+    if (!summary_array) {
+        return false;
+    }
+
+    uint32_t source_num = 0;
+
+    for (uint32_t i = 0; i < num; i++) {
+        const cache_manager_trace_event_t* event = &event_array[i];
+        source_summary_t* summary = &summary_array[event->source];
+
+        if (event->type >= _CACHE_MANAGER_TRACE_LAST) {
+            continue;
+        }
+
+        summary->cnt_array[event->type]++;
+
+        if (event->type == CACHE_MANAGER_TRACE_CREATE) {
+            summary->create_time_sum += event->value;
+            if (event->value > summary->create_time_max) {
+                summary->create_time_max = event->value;
+            }
+        }
+
+        if ((uint32_t)event->source + 1 > source_num) {
+            source_num = event->source + 1;
+        }
+    }
+
+    printf("source");
+    for (uint32_t type = 0; type < _CACHE_MANAGER_TRACE_LAST; type++) {
+        printf(",%s", cm_trace_get_type_name((cache_manager_trace_type_t)type));
+    }
+    printf(",hit_rate,create_avg,create_max\n");
+
+    for (uint32_t i = 0; i < source_num; i++) {
+        const source_summary_t* summary = &summary_array[i];
+        uint64_t hit_cnt = summary->cnt_array[CACHE_MANAGER_TRACE_HIT];
+        uint64_t open_cnt = hit_cnt + summary->cnt_array[CACHE_MANAGER_TRACE_MISS];
+        uint64_t create_cnt = summary->cnt_array[CACHE_MANAGER_TRACE_CREATE];
+
+        if (open_cnt == 0 && create_cnt == 0) {
+            continue;
+        }
+
+        printf("%" PRIu32, i);
+        for (uint32_t type = 0; type < _CACHE_MANAGER_TRACE_LAST; type++) {
+            printf(",%" PRIu64, summary->cnt_array[type]);
+        }
+        printf(",%.4f,%.1f,%" PRIu32 "\n",
+            open_cnt ? (double)hit_cnt / (double)open_cnt : 0.0,
+            create_cnt ? (double)summary->create_time_sum / (double)create_cnt : 0.0,
+            summary->create_time_max);
+    }
+
+    free(summary_array);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* path = NULL;
+    char option = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "-i") == 0) {
+            option = argv[i][1];
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return strcmp(argv[i], "-h") == 0 ? 0 : 1;
+        }
+    }
+
+    if (!path) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    uint32_t num = 0;
+    cache_manager_trace_event_t* event_array = cm_trace_load(path, &num);
+
+    if (!event_array) {
+        fprintf(stderr, "can't load %s\n", path);
+        return 1;
+    }
+
+    bool success = true;
+
+    if (option == 's') {
+        success = print_summary(event_array, num);
+    } else if (option == 'i') {
+        print_ids(event_array, num);
+    } else {
+        print_events(event_array, num);
+    }
+
+    cm_trace_free_events(event_array);
+    return success ? 0 : 1;
+}
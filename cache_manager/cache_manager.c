@@ -23,11 +23,14 @@
 
 #include "cache_manager.h"
 #include "cache_manager_config.h"
+#include "cache_manager_l2.h"
+#include "cache_manager_mrc.h"
+#include "cache_manager_adapt.h"
+#include "cache_manager_trace.h"
+#include "cache_manager_simd.h"
 #include <inttypes.h>
 #include <string.h>
 
-#define CACHE_MANAGER_INVALIDATE_ID 0
-
 /*Decrement life with this value on every open*/
 #define CACHE_MANAGER_AGING 1
 
@@ -38,7 +41,46 @@
  * "die" from very high values*/
 #define CACHE_MANAGER_LIFE_LIMIT 1000
 
-#define CACHE_MANAGER_REF_CNT_LIMIT 100
+/*Relative lives are rebased once life_epoch gets this far, and never go below
+ * the floor, so that aging by up to another rebase period can't wrap them*/
+#define CACHE_MANAGER_LIFE_REBASE ((uint32_t)1 << 30)
+#define CACHE_MANAGER_LIFE_FLOOR (-(int32_t)CACHE_MANAGER_LIFE_REBASE)
+
+/*Saturation limit of priv.ref_cnt, 0 means UINT32_MAX. LFU ranks entries by
+ * their bucket frequency, so the statistic doesn't need to be clamped low*/
+#define CACHE_MANAGER_REF_CNT_LIMIT 0
+
+/*Fixed point scale of GDSF priorities, so that cost / size keeps its fraction*/
+#define CACHE_MANAGER_GDSF_SCALE (1 << 16)
+
+/*W-TinyLFU: share of the capacity for the admission window, and share of
+ * the main space for the protected segment, in percent*/
+#define CACHE_MANAGER_WTINYLFU_WINDOW_PERCENT 1
+#define CACHE_MANAGER_WTINYLFU_PROTECTED_PERCENT 80
+
+/*W-TinyLFU: halve the frequency sketch after this many samples per node*/
+#define CACHE_MANAGER_WTINYLFU_SAMPLE_FACTOR 10
+
+/*cm_open_many: how many ids ahead the index buckets are prefetched*/
+#define CACHE_MANAGER_PREFETCH_DISTANCE 4
+
+/*FIFO: invalidated slots stay in the ring as tombstones until the tail
+ * reaches them, the ring is compacted once more than 1/N of it is dead*/
+#define CACHE_MANAGER_FIFO_TOMBSTONE_DIV 4
+#define CACHE_MANAGER_FIFO_TOMBSTONE 1 /* priv.pos of a tombstone */
+
+#define CACHE_MANAGER_NODE_NONE UINT32_MAX
+
+/*Segments of cache_manager_t.seg_list, the node's one is kept in priv.pos*/
+#define CACHE_MANAGER_ARC_T1 0
+#define CACHE_MANAGER_ARC_T2 1
+#define CACHE_MANAGER_WTINYLFU_WINDOW 0
+#define CACHE_MANAGER_WTINYLFU_PROBATION 1
+#define CACHE_MANAGER_WTINYLFU_PROTECTED 2
+
+/*Ghost lists of ARC, cache_manager_t.ghost_list*/
+#define CACHE_MANAGER_ARC_B1 0
+#define CACHE_MANAGER_ARC_B2 1
 
 static uint32_t cm_tick_elaps(cache_manager_t* cm, uint32_t prev_tick)
 {
@@ -55,374 +97,4016 @@ static uint32_t cm_tick_elaps(cache_manager_t* cm, uint32_t prev_tick)
     return prev_tick;
 }
 
-static bool cm_open_node(cache_manager_t* cm, cache_manager_node_t* node, int id)
+static void cm_stats_record(uint64_t* hist, uint32_t value)
 {
-    uint32_t start_time = 0;
-    cache_manager_node_t node_tmp = { 0 };
-
-    CM_LOG_INFO("id:%d creating...", id);
+    /*Bucket i holds values in [2^(i-1), 2^i), bucket 0 holds 0*/
+#if defined(__GNUC__)
+    uint32_t bucket = value ? 32 - (uint32_t)__builtin_clz(value) : 0;
+#else
+    uint32_t bucket = 0;
+    while (value >> bucket) {
+        bucket++;
+    }
+#endif
 
-    if (cm->tick_get_cb) {
-        start_time = cm->tick_get_cb();
+    if (bucket >= CACHE_MANAGER_HIST_BUCKET_NUM) {
+        bucket = CACHE_MANAGER_HIST_BUCKET_NUM - 1;
     }
 
-    node_tmp.cache_manager = cm;
-    node_tmp.id = id;
-    bool success = cm->create_cb(&node_tmp);
+    hist[bucket]++;
+}
 
-    if (cm->tick_get_cb) {
-        node_tmp.priv.time_to_open = cm_tick_elaps(cm, start_time);
-        CM_LOG_INFO("time cost: %" PRIu32, node_tmp.priv.time_to_open);
-    }
+static uint32_t cm_node_get_slot(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    return (uint32_t)(node - cm->cache_node_array);
+}
 
-    if (node_tmp.priv.time_to_open == 0) {
-        node_tmp.priv.time_to_open = 1;
+static void cm_trace_event(cache_manager_t* cm, cache_manager_trace_type_t type, int id, uint32_t value)
+{
+#if CACHE_MANAGER_USE_TRACE
+    if (cm->trace) {
+        cm_trace_record(cm->trace, type, cm->trace_source, cm->tick_get_cb ? cm->tick_get_cb() : 0, id, value);
     }
+#endif
+}
 
-    if (success) {
-        *node = node_tmp;
-    } else {
-        CM_LOG_WARN("id:%d create failed", id);
+static uint32_t cm_hash_id(int id)
+{
+    /*murmur3 finalizer, spreads sequential ids over the whole table*/
+    uint32_t h = (uint32_t)id;
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+static bool cm_resize_array(void** array_p, size_t size)
+{
+    /*Leave the array as it is on failure, a shrink can live with the old one*/
+    void* array = CACHE_MANAGER_REALLOC(*array_p, size);
+
+    if (!array) {
+        return false;
     }
 
-    return success;
+    *array_p = array;
+    return true;
 }
 
-static void cm_close_node(cache_manager_node_t* node)
+static uint32_t cm_index_get_size(uint32_t capacity)
 {
-    if (node->id == CACHE_MANAGER_INVALIDATE_ID) {
-        return;
+    /*Keep the load factor below 0.5 so that probe sequences stay short*/
+    uint32_t size = 8;
+    while (size < capacity * 2) {
+        size <<= 1;
     }
+    return size;
+}
 
-    cache_manager_t* cm = node->cache_manager;
+static bool cm_index_init(cache_manager_index_t* index, uint32_t capacity)
+{
+    uint32_t size = cm_index_get_size(capacity);
 
-    if (cm->delete_cb) {
-        cm->delete_cb(node);
+    if (index->table) {
+        CACHE_MANAGER_FREE(index->table);
     }
 
-    CM_LOG_INFO("id:%d closed, ref_cnt = %" PRIu32, node->id, node->priv.ref_cnt);
+    index->table = CACHE_MANAGER_MALLOC(sizeof(cache_manager_index_entry_t) * size);
 
-    memset(node, 0, sizeof(cache_manager_node_t));
+    if (!index->table) {
+        CM_LOG_ERROR("index table malloc failed");
+        index->mask = 0;
+        return false;
+    }
+
+    memset(index->table, 0, sizeof(cache_manager_index_entry_t) * size);
+    index->mask = size - 1;
+    return true;
 }
 
-static void cm_inc_node_ref_cnt(cache_manager_node_t* node)
+static void cm_index_deinit(cache_manager_index_t* index)
 {
-    node->priv.ref_cnt++;
-#if CACHE_MANAGER_REF_CNT_LIMIT
-    if (node->priv.ref_cnt > CACHE_MANAGER_REF_CNT_LIMIT) {
-        node->priv.ref_cnt = CACHE_MANAGER_REF_CNT_LIMIT;
+    if (index->table) {
+        CACHE_MANAGER_FREE(index->table);
+        index->table = NULL;
     }
-#endif
 }
 
-static cache_manager_node_t* cm_find_node(cache_manager_t* cm, int id)
+static void cm_index_insert(cache_manager_index_t* index, int id, uint32_t slot)
 {
-    for (uint32_t i = 0; i < cm->cache_num; i++) {
-        cache_manager_node_t* node = &(cm->cache_node_array[i]);
-        if (id == node->id) {
-            return node;
-        }
+    uint32_t pos = cm_hash_id(id) & index->mask;
+
+    while (index->table[pos].id != CACHE_MANAGER_INVALIDATE_ID) {
+        pos = (pos + 1) & index->mask;
     }
-    return NULL;
-}
 
-static cache_manager_node_t* cm_find_empty_node(cache_manager_t* cm)
-{
-    return cm_find_node(cm, CACHE_MANAGER_INVALIDATE_ID);
+    index->table[pos].id = id;
+    index->table[pos].slot = slot;
 }
 
-static cache_manager_node_t* cm_find_reuse_lfu(cache_manager_t* cm)
+static uint32_t cm_index_find(cache_manager_index_t* index, int id)
 {
-    cache_manager_node_t* reuse_node = NULL;
-    uint32_t ref_min = UINT32_MAX;
+    uint32_t pos = cm_hash_id(id) & index->mask;
 
-    for (uint32_t i = 0; i < cm->cache_num; i++) {
-        cache_manager_node_t* node = &(cm->cache_node_array[i]);
-        if (node->id != CACHE_MANAGER_INVALIDATE_ID) {
-            if (node->priv.ref_cnt < ref_min) {
-                reuse_node = node;
-            }
+    while (index->table[pos].id != CACHE_MANAGER_INVALIDATE_ID) {
+        if (index->table[pos].id == id) {
+            return index->table[pos].slot;
         }
+        pos = (pos + 1) & index->mask;
     }
-    return reuse_node;
+
+    return CACHE_MANAGER_NODE_NONE;
 }
 
-static cache_manager_node_t* cm_find_reuse_random(cache_manager_t* cm)
+#if CACHE_MANAGER_USE_HASH
+static void cm_index_prefetch(cache_manager_index_t* index, int id)
 {
-    uint32_t index = CACHE_MANAGER_RAND() % cm->cache_num;
-    return &(cm->cache_node_array[index]);
+#if defined(__GNUC__)
+    __builtin_prefetch(&index->table[cm_hash_id(id) & index->mask]);
+#else
+    (void)index;
+    (void)id;
+#endif
 }
+#endif
 
-static cache_manager_node_t* cm_find_reuse_lru_life(cache_manager_t* cm)
+static void cm_index_remove(cache_manager_index_t* index, int id)
 {
-    /*Find an entry to reuse. Select the entry with the least life*/
-    cache_manager_node_t* reuse_node = NULL;
-    int life_min = INT32_MAX;
-    for (uint32_t i = 0; i < cm->cache_num; i++) {
-        cache_manager_node_t* node = &(cm->cache_node_array[i]);
-        if (node->id != CACHE_MANAGER_INVALIDATE_ID
-            && node->priv.life < life_min) {
-            reuse_node = node;
-            life_min = node->priv.life;
+    uint32_t mask = index->mask;
+    uint32_t pos = cm_hash_id(id) & mask;
+
+    while (index->table[pos].id != id) {
+        if (index->table[pos].id == CACHE_MANAGER_INVALIDATE_ID) {
+            return;
         }
+        pos = (pos + 1) & mask;
     }
-    return reuse_node;
+
+    /*Backward shift deletion, no tombstones are left behind*/
+    uint32_t next = (pos + 1) & mask;
+    while (index->table[next].id != CACHE_MANAGER_INVALIDATE_ID) {
+        uint32_t home = cm_hash_id(index->table[next].id) & mask;
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            index->table[pos] = index->table[next];
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    index->table[pos].id = CACHE_MANAGER_INVALIDATE_ID;
 }
 
-static cache_manager_node_t* cm_node_fifo_peek(cache_manager_t* cm)
+#if CACHE_MANAGER_USE_HASH
+
+static cache_manager_node_t* cm_find_node(cache_manager_t* cm, int id)
 {
-    if (cm->cache_head == cm->cache_tail) {
+    uint32_t slot = cm_index_find(&cm->index, id);
+
+    if (slot == CACHE_MANAGER_NODE_NONE) {
         return NULL;
     }
 
-    return &(cm->cache_node_array[cm->cache_tail]);
+    return &(cm->cache_node_array[slot]);
 }
 
-static cache_manager_node_t* cm_node_fifo_pop(cache_manager_t* cm)
+#else
+
+static bool cm_id_array_init(cache_manager_t* cm)
 {
-    cache_manager_node_t* node = cm_node_fifo_peek(cm);
-    if (!node) {
-        return NULL;
+    if (!cm_resize_array((void**)&cm->id_array, sizeof(int) * cm->cache_num)) {
+        CM_LOG_ERROR("id_array malloc failed");
+        return false;
     }
 
-    cm->cache_tail = (cm->cache_tail + 1) % cm->cache_num;
-    return node;
+    memset(cm->id_array, 0, sizeof(int) * cm->cache_num);
+    return true;
 }
 
-static void cm_node_fifo_push(cache_manager_t* cm)
+static cache_manager_node_t* cm_find_node(cache_manager_t* cm, int id)
 {
-    uint32_t index = (uint32_t)(cm->cache_head + 1) % cm->cache_num;
-    if (index != cm->cache_tail) {
-        cm->cache_head = index;
+    /*Scan the packed ids instead of striding over whole nodes*/
+    uint32_t slot = cm_simd_find_id(cm->id_array, cm->cache_num, id);
+
+    if (slot == CACHE_MANAGER_NODE_NONE) {
+        return NULL;
     }
+
+    return &(cm->cache_node_array[slot]);
 }
 
-static cache_manager_node_t* cm_find_reuse_fifo(cache_manager_t* cm)
+#endif /* CACHE_MANAGER_USE_HASH */
+
+static cache_manager_node_t* cm_get_node(cache_manager_t* cm, uint32_t slot)
 {
-    return cm_node_fifo_peek(cm);
+    return &(cm->cache_node_array[slot]);
 }
 
-static cache_manager_node_t* cm_find_reuse_node(cache_manager_t* cm)
+static uint32_t cm_key_hash(const void* key, uint32_t len)
 {
-    switch (cm->mode) {
-    case CACHE_MANAGER_MODE_LFU:
-        return cm_find_reuse_lfu(cm);
-
-    case CACHE_MANAGER_MODE_RANDOM:
-        return cm_find_reuse_random(cm);
-
-    case CACHE_MANAGER_MODE_LIFE:
-    case CACHE_MANAGER_MODE_LRU:
-        return cm_find_reuse_lru_life(cm);
+    /*Multiply-xorshift over 8 byte words, folded to 32 bits at the end*/
+    const uint8_t* p = key;
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ len;
 
-    case CACHE_MANAGER_MODE_FIFO:
-        return cm_find_reuse_fifo(cm);
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+        p += 8;
+        len -= 8;
+    }
 
-    default:
-        CM_LOG_ERROR("unsupport cache mode: %d", cm->mode);
-        break;
+    if (len > 0) {
+        uint64_t w = 0;
+        memcpy(&w, p, len);
+        h = (h ^ w) * 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 32;
     }
 
-    return NULL;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 32;
+    return (uint32_t)h;
 }
 
-cache_manager_t* cm_create(
-    uint32_t cache_num,
-    cache_manager_mode_t mode,
-    cache_manager_user_cb_t create_cb,
-    cache_manager_user_cb_t delete_cb,
-    cache_manager_tick_get_cb_t tick_get_cb,
-    void* user_data)
+static const uint8_t* cm_key_get_data(const cache_manager_key_t* key)
 {
-    cache_manager_t* cm = CACHE_MANAGER_MALLOC(sizeof(cache_manager_t));
+    return key->len > CACHE_MANAGER_KEY_INLINE_SIZE ? key->buf.ptr : key->buf.data;
+}
 
-    if (!cm) {
-        CM_LOG_ERROR("cache_manager malloc failed");
-        return NULL;
-    }
+static bool cm_key_init(cache_manager_key_t* key, const void* data, uint32_t len, uint32_t hash)
+{
+    key->len = len;
+    key->hash = hash;
 
-    memset(cm, 0, sizeof(cache_manager_t));
+    if (len <= CACHE_MANAGER_KEY_INLINE_SIZE) {
+        memcpy(key->buf.data, data, len);
+        return true;
+    }
 
-    cm->cache_node_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_node_t) * cache_num);
+    key->buf.ptr = CACHE_MANAGER_MALLOC(len);
 
-    if (!cm->cache_node_array) {
-        CM_LOG_ERROR("cache_node_array malloc failed");
-        CACHE_MANAGER_FREE(cm);
-        return NULL;
+    if (!key->buf.ptr) {
+        CM_LOG_ERROR("key malloc failed");
+        key->len = 0;
+        return false;
     }
 
-    memset(cm->cache_node_array, 0, sizeof(cache_manager_node_t) * cache_num);
+    memcpy(key->buf.ptr, data, len);
+    return true;
+}
 
-    cm->cache_num = cache_num;
-    cm->mode = mode;
-    cm->create_cb = create_cb;
-    cm->delete_cb = delete_cb;
-    cm->tick_get_cb = tick_get_cb;
-    cm->user_data = user_data;
+static void cm_key_deinit(cache_manager_key_t* key)
+{
+    if (key->len > CACHE_MANAGER_KEY_INLINE_SIZE) {
+        CACHE_MANAGER_FREE(key->buf.ptr);
+    }
 
-    CM_LOG_INFO("cache_manager create OK, cache mode = %d, cache num = %d", mode, cache_num);
+    key->len = 0;
+}
 
-    return cm;
+static bool cm_key_equal(const cache_manager_key_t* key, const void* data, uint32_t len, uint32_t hash)
+{
+    return key->hash == hash && key->len == len && memcmp(cm_key_get_data(key), data, len) == 0;
 }
 
-void cm_set_cache_num(cache_manager_t* cm, uint32_t cache_num)
+static bool cm_key_table_init(cache_manager_t* cm)
 {
-    cm_clear(cm);
-    cm->cache_node_array = CACHE_MANAGER_REALLOC(cm->cache_node_array, cache_num);
+    uint32_t size = cm_index_get_size(cm->cache_num);
+    cache_manager_key_entry_t* table = CACHE_MANAGER_MALLOC(sizeof(cache_manager_key_entry_t) * size);
 
-    if (!cm->cache_node_array) {
-        CM_LOG_ERROR("cache_node_array realloc failed");
-        return;
+    if (!table) {
+        CM_LOG_ERROR("key table malloc failed");
+        return false;
     }
 
-    memset(cm->cache_node_array, 0, sizeof(cache_manager_node_t) * cache_num);
-    cm->cache_num = cache_num;
+    for (uint32_t i = 0; i < size; i++) {
+        table[i].slot = CACHE_MANAGER_NODE_NONE;
+    }
+
+    if (cm->key_table) {
+        CACHE_MANAGER_FREE(cm->key_table);
+    }
+
+    cm->key_table = table;
+    cm->key_mask = size - 1;
+    return true;
 }
 
-void cm_delete(cache_manager_t* cm)
+static void cm_key_table_deinit(cache_manager_t* cm)
 {
-    cm_clear(cm);
-    if (cm->cache_node_array) {
-        CACHE_MANAGER_FREE(cm->cache_node_array);
-        cm->cache_node_array = NULL;
+    if (cm->key_table) {
+        CACHE_MANAGER_FREE(cm->key_table);
+        cm->key_table = NULL;
     }
-    CACHE_MANAGER_FREE(cm);
+
+    cm->key_mask = 0;
 }
 
-cache_manager_res_t cm_open(cache_manager_t* cm, int id, cache_manager_node_t** node_p)
+static void cm_key_table_insert(cache_manager_t* cm, uint32_t hash, uint32_t slot)
 {
-    if (id == CACHE_MANAGER_INVALIDATE_ID) {
-        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    uint32_t pos = hash & cm->key_mask;
+
+    while (cm->key_table[pos].slot != CACHE_MANAGER_NODE_NONE) {
+        pos = (pos + 1) & cm->key_mask;
     }
 
-    cache_manager_node_t* node;
+    cm->key_table[pos].hash = hash;
+    cm->key_table[pos].slot = slot;
+}
 
-    cm->cache_open_cnt++;
+static uint32_t cm_key_table_find(cache_manager_t* cm, const void* data, uint32_t len, uint32_t hash)
+{
+    uint32_t pos = hash & cm->key_mask;
 
-    if (cm->mode == CACHE_MANAGER_MODE_LIFE || cm->mode == CACHE_MANAGER_MODE_LRU) {
-        /*Decrement all lifes. Make the entries older*/
-        node = &cm->cache_node_array[0];
-        for (uint32_t i = 0; i < cm->cache_num; i++) {
-            if (node->id != CACHE_MANAGER_INVALIDATE_ID
-                && node->priv.life > INT32_MIN + CACHE_MANAGER_AGING) {
-                node->priv.life -= CACHE_MANAGER_AGING;
-            }
-            node++;
+    while (cm->key_table[pos].slot != CACHE_MANAGER_NODE_NONE) {
+        /*Only a matching fingerprint costs a visit to the node*/
+        if (cm->key_table[pos].hash == hash
+            && cm_key_equal(&cm->key_array[cm->key_table[pos].slot], data, len, hash)) {
+            return cm->key_table[pos].slot;
         }
+        pos = (pos + 1) & cm->key_mask;
     }
 
-    node = cm_find_node(cm, id);
+    return CACHE_MANAGER_NODE_NONE;
+}
 
-    if (node) {
-        cm_inc_node_ref_cnt(node);
-        *node_p = node;
-        cm->cache_hit_cnt++;
-        CM_LOG_INFO("id:%d cache hit context %p, ref_cnt = %" PRIu32, node->id, node->context.ptr, node->priv.ref_cnt);
+static uint32_t cm_key_table_find_slot(cache_manager_t* cm, uint32_t hash, uint32_t slot)
+{
+    uint32_t pos = hash & cm->key_mask;
 
-        if (cm->mode == CACHE_MANAGER_MODE_LIFE || cm->mode == CACHE_MANAGER_MODE_LRU) {
-            uint32_t gain = (cm->mode == CACHE_MANAGER_MODE_LRU) ? 1 : node->priv.time_to_open;
-            node->priv.life += gain * CACHE_MANAGER_LIFE_GAIN;
+    while (cm->key_table[pos].slot != slot) {
+        pos = (pos + 1) & cm->key_mask;
+    }
 
-            if (node->priv.life > CACHE_MANAGER_LIFE_LIMIT) {
-                node->priv.life = CACHE_MANAGER_LIFE_LIMIT;
-            }
-        }
+    return pos;
+}
 
-        return CACHE_MANAGER_RES_OK;
-    }
+static void cm_key_table_remove(cache_manager_t* cm, uint32_t hash, uint32_t slot)
+{
+    uint32_t mask = cm->key_mask;
+    uint32_t pos = cm_key_table_find_slot(cm, hash, slot);
 
-    CM_LOG_INFO("cache miss, find empty node...");
+    /*Backward shift deletion like cm_index_remove()*/
+    uint32_t next = (pos + 1) & mask;
+    while (cm->key_table[next].slot != CACHE_MANAGER_NODE_NONE) {
+        uint32_t home = cm->key_table[next].hash & mask;
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            cm->key_table[pos] = cm->key_table[next];
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
 
-    node = cm_find_empty_node(cm);
+    cm->key_table[pos].slot = CACHE_MANAGER_NODE_NONE;
+}
 
-    if (node) {
-        if (cm_open_node(cm, node, id)) {
-            cm_inc_node_ref_cnt(node);
-            *node_p = node;
+static int cm_key_get_id(uint32_t hash)
+{
+    /*Positive and never CACHE_MANAGER_INVALIDATE_ID*/
+    int id = (int)(hash & 0x7FFFFFFF);
+    return id != CACHE_MANAGER_INVALIDATE_ID ? id : 1;
+}
 
-            if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
-                cm_node_fifo_push(cm);
-            }
+static cache_manager_key_t* cm_key_get_staged(cache_manager_t* cm)
+{
+    /*The key of the node being created waits past the slots*/
+    return &cm->key_array[cm->cache_num];
+}
 
-            return CACHE_MANAGER_RES_OK;
-        } else {
-            return CACHE_MANAGER_RES_ERR_CREATE_FAILED;
-        }
+static void cm_key_drop_staged(cache_manager_t* cm)
+{
+    if (cm->key_array) {
+        cm_key_deinit(cm_key_get_staged(cm));
     }
+}
 
-    CM_LOG_INFO("cache array full, find reuse node...");
+static void cm_list_init(cache_manager_list_t* list)
+{
+    list->head = list->tail = CACHE_MANAGER_NODE_NONE;
+    list->cnt = 0;
+}
 
-    node = cm_find_reuse_node(cm);
-    if (node) {
-        cache_manager_node_t node_tmp = { 0 };
+static void cm_list_push_front(cache_manager_t* cm, cache_manager_list_t* list, cache_manager_node_t* node)
+{
+    uint32_t slot = cm_node_get_slot(cm, node);
 
-        if (cm_open_node(cm, &node_tmp, id)) {
-            cm_close_node(node);
-            cm_inc_node_ref_cnt(&node_tmp);
+    node->priv.prev = CACHE_MANAGER_NODE_NONE;
+    node->priv.next = list->head;
+
+    if (list->head != CACHE_MANAGER_NODE_NONE) {
+        cm_get_node(cm, list->head)->priv.prev = slot;
+    } else {
+        list->tail = slot;
+    }
 
-            *node = node_tmp;
-            *node_p = node;
+    list->head = slot;
+    list->cnt++;
+}
 
-            if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
-                cm_node_fifo_pop(cm);
-                cm_node_fifo_push(cm);
-            }
+static void cm_list_push_back(cache_manager_t* cm, cache_manager_list_t* list, cache_manager_node_t* node)
+{
+    uint32_t slot = cm_node_get_slot(cm, node);
 
-            return CACHE_MANAGER_RES_OK;
-        } else {
-            return CACHE_MANAGER_RES_ERR_CREATE_FAILED;
-        }
-    }
+    node->priv.prev = list->tail;
+    node->priv.next = CACHE_MANAGER_NODE_NONE;
 
-    CM_LOG_ERROR("can't find reuse node");
+    if (list->tail != CACHE_MANAGER_NODE_NONE) {
+        cm_get_node(cm, list->tail)->priv.next = slot;
+    } else {
+        list->head = slot;
+    }
 
-    return CACHE_MANAGER_RES_ERR_UNKNOW;
+    list->tail = slot;
+    list->cnt++;
 }
 
-cache_manager_res_t cm_invalidate(cache_manager_t* cm, int id)
+static void cm_list_remove(cache_manager_t* cm, cache_manager_list_t* list, cache_manager_node_t* node)
 {
-    if (id == CACHE_MANAGER_INVALIDATE_ID) {
-        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    if (node->priv.prev != CACHE_MANAGER_NODE_NONE) {
+        cm_get_node(cm, node->priv.prev)->priv.next = node->priv.next;
+    } else {
+        list->head = node->priv.next;
     }
 
-    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
-        CM_LOG_WARN("FIFO mode not support invalidate");
-        return CACHE_MANAGER_RES_ERR_MODE;
+    if (node->priv.next != CACHE_MANAGER_NODE_NONE) {
+        cm_get_node(cm, node->priv.next)->priv.prev = node->priv.prev;
+    } else {
+        list->tail = node->priv.prev;
     }
 
-    for (uint32_t i = 0; i < cm->cache_num; i++) {
-        cache_manager_node_t* node = &(cm->cache_node_array[i]);
-        if (id == node->id) {
-            cm_close_node(node);
-            return CACHE_MANAGER_RES_OK;
+    node->priv.prev = node->priv.next = CACHE_MANAGER_NODE_NONE;
+    list->cnt--;
+}
+
+static cache_manager_node_t* cm_list_peek_unpinned(cache_manager_t* cm, cache_manager_list_t* list)
+{
+    /*Walk from the tail, skipping nodes which are still in use*/
+    uint32_t slot = list->tail;
+
+    while (slot != CACHE_MANAGER_NODE_NONE) {
+        cache_manager_node_t* node = cm_get_node(cm, slot);
+
+        if (node->priv.pin_cnt == 0) {
+            return node;
         }
+
+        slot = node->priv.prev;
     }
 
-    return CACHE_MANAGER_RES_ERR_ID_NOT_FOUND;
+    return NULL;
 }
 
-void cm_clear(cache_manager_t* cm)
+static int32_t cm_get_node_life(cache_manager_t* cm, cache_manager_node_t* node)
 {
-    cm->cache_head = cm->cache_tail = 0;
-    for (uint32_t i = 0; i < cm->cache_num; i++) {
-        cache_manager_node_t* node = &(cm->cache_node_array[i]);
-        if (node->id != CACHE_MANAGER_INVALIDATE_ID) {
-            cm_close_node(node);
-        }
-    }
+    /*life is stored relative to life_epoch, which grows instead of aging every node*/
+    return (int32_t)((uint32_t)node->priv.life - cm->life_epoch);
 }
 
-int cm_get_cache_hit_rate(cache_manager_t* cm)
+static void cm_set_node_life(cache_manager_t* cm, cache_manager_node_t* node, int32_t life)
 {
-    if (cm->cache_open_cnt == 0) {
-        return 0;
+    if (life < CACHE_MANAGER_LIFE_FLOOR) {
+        life = CACHE_MANAGER_LIFE_FLOOR;
     }
 
-    return cm->cache_hit_cnt * 1000 / cm->cache_open_cnt;
+    node->priv.life = (int32_t)((uint32_t)life + cm->life_epoch);
 }
 
-void cm_reset_cache_hit_cnt(cache_manager_t* cm)
+static uint64_t cm_gdsf_calc_priority(cache_manager_t* cm, cache_manager_node_t* node)
 {
-    cm->cache_hit_cnt = 0;
-    cm->cache_open_cnt = 0;
+    /*GreedyDual-Size-Frequency: H = L + frequency * cost / size*/
+    uint64_t size = node->context.size ? node->context.size : 1;
+    uint64_t value = (uint64_t)node->priv.ref_cnt * node->priv.time_to_open * CACHE_MANAGER_GDSF_SCALE / size;
+    return cm->gdsf_age + value;
+}
+
+static bool cm_mode_use_heap(cache_manager_mode_t mode)
+{
+    return mode == CACHE_MANAGER_MODE_LIFE || mode == CACHE_MANAGER_MODE_GDSF;
+}
+
+static bool cm_heap_less(cache_manager_t* cm, uint32_t a, uint32_t b)
+{
+    if (cm->mode == CACHE_MANAGER_MODE_GDSF) {
+        uint64_t priority_a = cm->gdsf_priority_array[a];
+        uint64_t priority_b = cm->gdsf_priority_array[b];
+        return priority_a < priority_b || (priority_a == priority_b && a < b);
+    }
+
+    int32_t life_a = cm_get_node_life(cm, cm_get_node(cm, a));
+    int32_t life_b = cm_get_node_life(cm, cm_get_node(cm, b));
+
+    /*Ties go to the lower slot, like the old front-to-back scan*/
+    return life_a < life_b || (life_a == life_b && a < b);
+}
+
+static void cm_heap_set(cache_manager_t* cm, uint32_t pos, uint32_t slot)
+{
+    cm->heap_array[pos] = slot;
+    cm_get_node(cm, slot)->priv.pos = pos;
+}
+
+static void cm_heap_sift_up(cache_manager_t* cm, uint32_t pos)
+{
+    uint32_t slot = cm->heap_array[pos];
+
+    while (pos > 0) {
+        uint32_t parent = (pos - 1) / 2;
+        if (!cm_heap_less(cm, slot, cm->heap_array[parent])) {
+            break;
+        }
+        cm_heap_set(cm, pos, cm->heap_array[parent]);
+        pos = parent;
+    }
+
+    cm_heap_set(cm, pos, slot);
+}
+
+static void cm_heap_sift_down(cache_manager_t* cm, uint32_t pos)
+{
+    uint32_t slot = cm->heap_array[pos];
+
+    while (true) {
+        uint32_t child = pos * 2 + 1;
+        if (child >= cm->heap_cnt) {
+            break;
+        }
+        if (child + 1 < cm->heap_cnt && cm_heap_less(cm, cm->heap_array[child + 1], cm->heap_array[child])) {
+            child++;
+        }
+        if (!cm_heap_less(cm, cm->heap_array[child], slot)) {
+            break;
+        }
+        cm_heap_set(cm, pos, cm->heap_array[child]);
+        pos = child;
+    }
+
+    cm_heap_set(cm, pos, slot);
+}
+
+static void cm_heap_push(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    cm_heap_set(cm, cm->heap_cnt, cm_node_get_slot(cm, node));
+    cm->heap_cnt++;
+    cm_heap_sift_up(cm, cm->heap_cnt - 1);
+}
+
+static void cm_heap_remove(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    uint32_t pos = node->priv.pos;
+
+    if (pos == CACHE_MANAGER_NODE_NONE) {
+        return;
+    }
+
+    cm->heap_cnt--;
+    if (pos != cm->heap_cnt) {
+        uint32_t last = cm->heap_array[cm->heap_cnt];
+        cm_heap_set(cm, pos, last);
+
+        if (pos > 0 && cm_heap_less(cm, last, cm->heap_array[(pos - 1) / 2])) {
+            cm_heap_sift_up(cm, pos);
+        } else {
+            cm_heap_sift_down(cm, pos);
+        }
+    }
+
+    node->priv.pos = CACHE_MANAGER_NODE_NONE;
+}
+
+static cache_manager_node_t* cm_heap_peek(cache_manager_t* cm)
+{
+    if (cm->heap_cnt == 0) {
+        return NULL;
+    }
+
+    return cm_get_node(cm, cm->heap_array[0]);
+}
+
+static void cm_heap_build(cache_manager_t* cm)
+{
+    /*Floyd's bottom-up heapify, for when many keys changed at once*/
+    for (uint32_t pos = cm->heap_cnt / 2; pos > 0; pos--) {
+        cm_heap_sift_down(cm, pos - 1);
+    }
+}
+
+static void cm_life_age(cache_manager_t* cm)
+{
+    /*Make all the entries older at once by moving the life origin*/
+    cm->life_epoch += CACHE_MANAGER_AGING;
+
+    if (cm->life_epoch < CACHE_MANAGER_LIFE_REBASE) {
+        return;
+    }
+
+    /*Store the lives relative to a new origin, clamping the coldest ones like
+     *the per-node aging did. Clamped lives become equal and then tie by slot,
+     *which may not match their heap positions, so the heap is rebuilt*/
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cache_manager_node_t* node = &(cm->cache_node_array[i]);
+
+        if (node->id != CACHE_MANAGER_INVALIDATE_ID) {
+            int32_t life = cm_get_node_life(cm, node);
+            node->priv.life = (life < CACHE_MANAGER_LIFE_FLOOR) ? CACHE_MANAGER_LIFE_FLOOR : life;
+        }
+    }
+
+    cm->life_epoch = 0;
+    cm_heap_build(cm);
+}
+
+static cache_manager_lfu_bucket_t* cm_lfu_get_bucket(cache_manager_t* cm, uint32_t index)
+{
+    return &(cm->lfu_bucket_array[index]);
+}
+
+static void cm_lfu_init(cache_manager_t* cm)
+{
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cm->lfu_bucket_array[i].next = i + 1;
+    }
+
+    if (cm->cache_num > 0) {
+        cm->lfu_bucket_array[cm->cache_num - 1].next = CACHE_MANAGER_NODE_NONE;
+    }
+
+    cm->lfu_bucket_free = cm->cache_num > 0 ? 0 : CACHE_MANAGER_NODE_NONE;
+    cm->lfu_bucket_head = CACHE_MANAGER_NODE_NONE;
+    cm->lfu_age = 0;
+}
+
+static uint32_t cm_lfu_bucket_insert(cache_manager_t* cm, uint32_t prev, uint32_t freq)
+{
+    /*There are never more buckets than resident nodes, so the pool can't run dry*/
+    uint32_t index = cm->lfu_bucket_free;
+    cache_manager_lfu_bucket_t* bucket = cm_lfu_get_bucket(cm, index);
+    cm->lfu_bucket_free = bucket->next;
+
+    bucket->freq = freq;
+    cm_list_init(&bucket->list);
+    bucket->prev = prev;
+    bucket->next = (prev == CACHE_MANAGER_NODE_NONE) ? cm->lfu_bucket_head : cm_lfu_get_bucket(cm, prev)->next;
+
+    if (bucket->next != CACHE_MANAGER_NODE_NONE) {
+        cm_lfu_get_bucket(cm, bucket->next)->prev = index;
+    }
+
+    if (prev == CACHE_MANAGER_NODE_NONE) {
+        cm->lfu_bucket_head = index;
+    } else {
+        cm_lfu_get_bucket(cm, prev)->next = index;
+    }
+
+    return index;
+}
+
+static void cm_lfu_bucket_remove(cache_manager_t* cm, uint32_t index)
+{
+    cache_manager_lfu_bucket_t* bucket = cm_lfu_get_bucket(cm, index);
+
+    if (bucket->prev != CACHE_MANAGER_NODE_NONE) {
+        cm_lfu_get_bucket(cm, bucket->prev)->next = bucket->next;
+    } else {
+        cm->lfu_bucket_head = bucket->next;
+    }
+
+    if (bucket->next != CACHE_MANAGER_NODE_NONE) {
+        cm_lfu_get_bucket(cm, bucket->next)->prev = bucket->prev;
+    }
+
+    bucket->next = cm->lfu_bucket_free;
+    cm->lfu_bucket_free = index;
+}
+
+static void cm_lfu_link_node(cache_manager_t* cm, cache_manager_node_t* node, uint32_t prev, uint32_t freq)
+{
+    /*Buckets are sorted by frequency, the target is either right after prev or new*/
+    uint32_t next = (prev == CACHE_MANAGER_NODE_NONE) ? cm->lfu_bucket_head : cm_lfu_get_bucket(cm, prev)->next;
+    uint32_t index;
+
+    if (next != CACHE_MANAGER_NODE_NONE && cm_lfu_get_bucket(cm, next)->freq == freq) {
+        index = next;
+    } else {
+        index = cm_lfu_bucket_insert(cm, prev, freq);
+    }
+
+    cm_list_push_front(cm, &cm_lfu_get_bucket(cm, index)->list, node);
+    node->priv.pos = index;
+}
+
+static uint32_t cm_lfu_unlink_node(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    /*Return the bucket a higher frequency has to be linked after*/
+    uint32_t index = node->priv.pos;
+    cache_manager_lfu_bucket_t* bucket = cm_lfu_get_bucket(cm, index);
+
+    cm_list_remove(cm, &bucket->list, node);
+    node->priv.pos = CACHE_MANAGER_NODE_NONE;
+
+    if (bucket->list.head == CACHE_MANAGER_NODE_NONE) {
+        uint32_t prev = bucket->prev;
+        cm_lfu_bucket_remove(cm, index);
+        return prev;
+    }
+
+    return index;
+}
+
+static void cm_lfu_attach(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    /*Every frequency is >= lfu_age, so lfu_age + 1 is in the first or second bucket*/
+    uint32_t freq = cm->lfu_age + 1;
+    uint32_t prev = CACHE_MANAGER_NODE_NONE;
+
+    if (cm->lfu_bucket_head != CACHE_MANAGER_NODE_NONE
+        && cm_lfu_get_bucket(cm, cm->lfu_bucket_head)->freq < freq) {
+        prev = cm->lfu_bucket_head;
+    }
+
+    cm_lfu_link_node(cm, node, prev, freq);
+}
+
+static void cm_lfu_touch(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    uint32_t freq = cm_lfu_get_bucket(cm, node->priv.pos)->freq;
+
+    if (freq == UINT32_MAX) {
+        return;
+    }
+
+    uint32_t prev = cm_lfu_unlink_node(cm, node);
+    cm_lfu_link_node(cm, node, prev, freq + 1);
+}
+
+static cache_manager_node_t* cm_lfu_peek(cache_manager_t* cm)
+{
+    if (cm->lfu_bucket_head == CACHE_MANAGER_NODE_NONE) {
+        return NULL;
+    }
+
+#if CACHE_MANAGER_LFU_USE_AGING
+    /*Age with the lowest frequency, even if its nodes are all pinned*/
+    cm->lfu_age = cm_lfu_get_bucket(cm, cm->lfu_bucket_head)->freq;
+#endif
+
+    /*Within the least frequent bucket, evict the entry that got there first*/
+    uint32_t index = cm->lfu_bucket_head;
+
+    while (index != CACHE_MANAGER_NODE_NONE) {
+        cache_manager_lfu_bucket_t* bucket = cm_lfu_get_bucket(cm, index);
+        cache_manager_node_t* node = cm_list_peek_unpinned(cm, &bucket->list);
+
+        if (node) {
+            return node;
+        }
+
+        index = bucket->next;
+    }
+
+    return NULL;
+}
+
+static void cm_seg_move_front(cache_manager_t* cm, cache_manager_node_t* node, uint32_t seg)
+{
+    cm_list_remove(cm, &cm->seg_list[node->priv.pos], node);
+    cm_list_push_front(cm, &cm->seg_list[seg], node);
+    node->priv.pos = seg;
+}
+
+static void cm_seg_move_back(cache_manager_t* cm, cache_manager_node_t* node, uint32_t seg)
+{
+    cm_list_remove(cm, &cm->seg_list[node->priv.pos], node);
+    cm_list_push_back(cm, &cm->seg_list[seg], node);
+    node->priv.pos = seg;
+}
+
+static cache_manager_ghost_t* cm_ghost_get(cache_manager_t* cm, uint32_t index)
+{
+    return &(cm->ghost_array[index]);
+}
+
+static bool cm_ghost_init(cache_manager_t* cm)
+{
+    /*|T1| + |T2| + |B1| + |B2| <= 2c, so c + 1 ghosts cover a full cache plus the victim*/
+    uint32_t ghost_num = cm->cache_num + 1;
+
+    if (!cm_resize_array((void**)&cm->ghost_array, sizeof(cache_manager_ghost_t) * ghost_num)
+        || !cm_index_init(&cm->ghost_index, ghost_num)) {
+        CM_LOG_ERROR("ghost malloc failed");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < ghost_num; i++) {
+        cm->ghost_array[i].next = i + 1;
+    }
+    cm->ghost_array[ghost_num - 1].next = CACHE_MANAGER_NODE_NONE;
+    cm->ghost_free = 0;
+
+    cm_list_init(&cm->ghost_list[CACHE_MANAGER_ARC_B1]);
+    cm_list_init(&cm->ghost_list[CACHE_MANAGER_ARC_B2]);
+    return true;
+}
+
+static void cm_ghost_remove(cache_manager_t* cm, uint32_t index)
+{
+    cache_manager_ghost_t* ghost = cm_ghost_get(cm, index);
+    cache_manager_list_t* list = &cm->ghost_list[ghost->list];
+
+    if (ghost->prev != CACHE_MANAGER_NODE_NONE) {
+        cm_ghost_get(cm, ghost->prev)->next = ghost->next;
+    } else {
+        list->head = ghost->next;
+    }
+
+    if (ghost->next != CACHE_MANAGER_NODE_NONE) {
+        cm_ghost_get(cm, ghost->next)->prev = ghost->prev;
+    } else {
+        list->tail = ghost->prev;
+    }
+
+    list->cnt--;
+    cm_index_remove(&cm->ghost_index, ghost->id);
+
+    ghost->next = cm->ghost_free;
+    cm->ghost_free = index;
+}
+
+static void cm_ghost_drop_tail(cache_manager_t* cm, uint32_t list)
+{
+    if (cm->ghost_list[list].tail != CACHE_MANAGER_NODE_NONE) {
+        cm_ghost_remove(cm, cm->ghost_list[list].tail);
+    }
+}
+
+static void cm_ghost_add(cache_manager_t* cm, uint32_t list, int id)
+{
+    if (cm->ghost_free == CACHE_MANAGER_NODE_NONE) {
+        cm_ghost_drop_tail(cm, cm->ghost_list[CACHE_MANAGER_ARC_B2].cnt > 0 ? CACHE_MANAGER_ARC_B2 : CACHE_MANAGER_ARC_B1);
+    }
+
+    uint32_t index = cm->ghost_free;
+    cache_manager_ghost_t* ghost = cm_ghost_get(cm, index);
+    cm->ghost_free = ghost->next;
+
+    ghost->id = id;
+    ghost->list = list;
+    ghost->prev = CACHE_MANAGER_NODE_NONE;
+    ghost->next = cm->ghost_list[list].head;
+
+    if (ghost->next != CACHE_MANAGER_NODE_NONE) {
+        cm_ghost_get(cm, ghost->next)->prev = index;
+    } else {
+        cm->ghost_list[list].tail = index;
+    }
+
+    cm->ghost_list[list].head = index;
+    cm->ghost_list[list].cnt++;
+    cm_index_insert(&cm->ghost_index, id, index);
+}
+
+static void cm_arc_admit(cache_manager_t* cm, int id)
+{
+    cm->arc_ghost_hit = CACHE_MANAGER_NODE_NONE;
+
+    uint32_t index = cm_index_find(&cm->ghost_index, id);
+
+    if (index == CACHE_MANAGER_NODE_NONE) {
+        return;
+    }
+
+    /*A ghost hit tells which side would have kept the entry, adapt the T1 target*/
+    uint32_t b1 = cm->ghost_list[CACHE_MANAGER_ARC_B1].cnt;
+    uint32_t b2 = cm->ghost_list[CACHE_MANAGER_ARC_B2].cnt;
+    uint32_t list = cm_ghost_get(cm, index)->list;
+
+    if (list == CACHE_MANAGER_ARC_B1) {
+        uint32_t delta = b1 >= b2 ? 1 : b2 / b1;
+        cm->arc_p = (cm->arc_p + delta > cm->cache_num) ? cm->cache_num : cm->arc_p + delta;
+    } else {
+        uint32_t delta = b2 >= b1 ? 1 : b1 / b2;
+        cm->arc_p = (cm->arc_p > delta) ? cm->arc_p - delta : 0;
+    }
+
+    cm_ghost_remove(cm, index);
+    cm->arc_ghost_hit = list;
+}
+
+static cache_manager_node_t* cm_arc_peek(cache_manager_t* cm)
+{
+    /*REPLACE: evict from T1 while it's above its target p, else from T2*/
+    uint32_t t1 = cm->seg_list[CACHE_MANAGER_ARC_T1].cnt;
+    bool from_t1 = t1 > 0
+        && (t1 > cm->arc_p || (cm->arc_ghost_hit == CACHE_MANAGER_ARC_B2 && t1 == cm->arc_p));
+
+    cache_manager_list_t* first = &cm->seg_list[from_t1 ? CACHE_MANAGER_ARC_T1 : CACHE_MANAGER_ARC_T2];
+    cache_manager_list_t* second = &cm->seg_list[from_t1 ? CACHE_MANAGER_ARC_T2 : CACHE_MANAGER_ARC_T1];
+
+    cache_manager_node_t* node = cm_list_peek_unpinned(cm, first);
+    return node ? node : cm_list_peek_unpinned(cm, second);
+}
+
+static void cm_arc_evict(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    uint32_t list = (node->priv.pos == CACHE_MANAGER_ARC_T1) ? CACHE_MANAGER_ARC_B1 : CACHE_MANAGER_ARC_B2;
+    cm_ghost_add(cm, list, node->id);
+
+    /*Keep |T1| + |B1| <= c and the whole directory <= 2c*/
+    uint32_t t1 = cm->seg_list[CACHE_MANAGER_ARC_T1].cnt;
+    uint32_t t2 = cm->seg_list[CACHE_MANAGER_ARC_T2].cnt;
+
+    while (cm->ghost_list[CACHE_MANAGER_ARC_B1].cnt > 0
+        && t1 + cm->ghost_list[CACHE_MANAGER_ARC_B1].cnt > cm->cache_num) {
+        cm_ghost_drop_tail(cm, CACHE_MANAGER_ARC_B1);
+    }
+
+    while (cm->ghost_list[CACHE_MANAGER_ARC_B2].cnt > 0
+        && t1 + t2 + cm->ghost_list[CACHE_MANAGER_ARC_B1].cnt + cm->ghost_list[CACHE_MANAGER_ARC_B2].cnt > cm->cache_num * 2) {
+        cm_ghost_drop_tail(cm, CACHE_MANAGER_ARC_B2);
+    }
+}
+
+static uint32_t cm_sketch_get_width(uint32_t cache_num)
+{
+    uint32_t width = 64;
+    while (width < cache_num * 2) {
+        width <<= 1;
+    }
+    return width;
+}
+
+static bool cm_sketch_init(cache_manager_t* cm)
+{
+    /*4 rows of 4-bit counters, 16 counters per word*/
+    uint32_t width = cm_sketch_get_width(cm->cache_num);
+    uint32_t word_num = width / 16 * 4;
+
+    if (!cm_resize_array((void**)&cm->sketch_array, sizeof(uint64_t) * word_num)) {
+        CM_LOG_ERROR("sketch_array malloc failed");
+        return false;
+    }
+
+    memset(cm->sketch_array, 0, sizeof(uint64_t) * word_num);
+    cm->sketch_mask = width - 1;
+    cm->sketch_sample_cnt = 0;
+    cm->sketch_sample_limit = cm->cache_num * CACHE_MANAGER_WTINYLFU_SAMPLE_FACTOR;
+    return true;
+}
+
+static uint32_t cm_sketch_get_pos(cache_manager_t* cm, int id, uint32_t row)
+{
+    /*Double hashing gives each row its own counter*/
+    uint32_t h1 = cm_hash_id(id);
+    uint32_t h2 = ((h1 >> 16) | (h1 << 16)) * 0x9E3779B1 | 1;
+    uint32_t pos = (h1 + row * h2) & cm->sketch_mask;
+    return (cm->sketch_mask + 1) * row + pos;
+}
+
+static uint32_t cm_sketch_estimate(cache_manager_t* cm, int id)
+{
+    uint32_t freq = 15;
+
+    for (uint32_t row = 0; row < 4; row++) {
+        uint32_t pos = cm_sketch_get_pos(cm, id, row);
+        uint32_t cnt = (uint32_t)(cm->sketch_array[pos / 16] >> ((pos % 16) * 4)) & 0xF;
+        if (cnt < freq) {
+            freq = cnt;
+        }
+    }
+
+    return freq;
+}
+
+static void cm_sketch_increment(cache_manager_t* cm, int id)
+{
+    for (uint32_t row = 0; row < 4; row++) {
+        uint32_t pos = cm_sketch_get_pos(cm, id, row);
+        uint32_t shift = (pos % 16) * 4;
+        if (((cm->sketch_array[pos / 16] >> shift) & 0xF) < 0xF) {
+            cm->sketch_array[pos / 16] += (uint64_t)1 << shift;
+        }
+    }
+
+    if (++cm->sketch_sample_cnt >= cm->sketch_sample_limit) {
+        /*Halve every counter at once so that old popularity fades*/
+        uint32_t word_num = (cm->sketch_mask + 1) / 16 * 4;
+        for (uint32_t i = 0; i < word_num; i++) {
+            cm->sketch_array[i] = (cm->sketch_array[i] >> 1) & 0x7777777777777777ULL;
+        }
+        cm->sketch_sample_cnt /= 2;
+    }
+}
+
+static uint32_t cm_wtinylfu_get_window_max(cache_manager_t* cm)
+{
+    uint32_t window = cm->cache_num * CACHE_MANAGER_WTINYLFU_WINDOW_PERCENT / 100;
+    return window > 0 ? window : 1;
+}
+
+static void cm_wtinylfu_touch(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    cm_sketch_increment(cm, node->id);
+
+    if (node->priv.pos != CACHE_MANAGER_WTINYLFU_PROBATION) {
+        cm_seg_move_front(cm, node, node->priv.pos);
+        return;
+    }
+
+    /*A second hit promotes from probation, overflow goes back to probation*/
+    cm_seg_move_front(cm, node, CACHE_MANAGER_WTINYLFU_PROTECTED);
+
+    uint32_t main_max = cm->cache_num - cm_wtinylfu_get_window_max(cm);
+    cache_manager_list_t* protected_list = &cm->seg_list[CACHE_MANAGER_WTINYLFU_PROTECTED];
+
+    if (protected_list->cnt > main_max * CACHE_MANAGER_WTINYLFU_PROTECTED_PERCENT / 100) {
+        cm_seg_move_front(cm, cm_get_node(cm, protected_list->tail), CACHE_MANAGER_WTINYLFU_PROBATION);
+    }
+}
+
+static void cm_wtinylfu_attach(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    node->priv.pos = CACHE_MANAGER_WTINYLFU_WINDOW;
+    cm_list_push_front(cm, &cm->seg_list[node->priv.pos], node);
+
+    /*While the cache fills up there is no victim to compete with, so the
+     *window overflows into probation without the admission check*/
+    cache_manager_list_t* window_list = &cm->seg_list[CACHE_MANAGER_WTINYLFU_WINDOW];
+    uint32_t window_max = cm_wtinylfu_get_window_max(cm);
+    uint32_t main_cnt = cm->seg_list[CACHE_MANAGER_WTINYLFU_PROBATION].cnt + cm->seg_list[CACHE_MANAGER_WTINYLFU_PROTECTED].cnt;
+
+    while (window_list->cnt > window_max && main_cnt < cm->cache_num - window_max) {
+        cm_seg_move_front(cm, cm_get_node(cm, window_list->tail), CACHE_MANAGER_WTINYLFU_PROBATION);
+        main_cnt++;
+    }
+}
+
+static cache_manager_node_t* cm_wtinylfu_peek(cache_manager_t* cm)
+{
+    cache_manager_node_t* candidate = NULL;
+
+    if (cm->seg_list[CACHE_MANAGER_WTINYLFU_WINDOW].cnt >= cm_wtinylfu_get_window_max(cm)) {
+        candidate = cm_list_peek_unpinned(cm, &cm->seg_list[CACHE_MANAGER_WTINYLFU_WINDOW]);
+    }
+
+    cache_manager_node_t* victim = cm_list_peek_unpinned(cm, &cm->seg_list[CACHE_MANAGER_WTINYLFU_PROBATION]);
+
+    if (!victim) {
+        victim = cm_list_peek_unpinned(cm, &cm->seg_list[CACHE_MANAGER_WTINYLFU_PROTECTED]);
+    }
+
+    if (candidate && victim) {
+        /*Admission: the window's victim only enters the main space if it's more popular*/
+        if (cm_sketch_estimate(cm, candidate->id) > cm_sketch_estimate(cm, victim->id)) {
+            cm_seg_move_front(cm, candidate, CACHE_MANAGER_WTINYLFU_PROBATION);
+            return victim;
+        }
+        return candidate;
+    }
+
+    if (candidate) {
+        return candidate;
+    }
+
+    if (victim) {
+        return victim;
+    }
+
+    return cm_list_peek_unpinned(cm, &cm->seg_list[CACHE_MANAGER_WTINYLFU_WINDOW]);
+}
+
+static void cm_clock_set_ref(cache_manager_t* cm, uint32_t slot, bool ref)
+{
+    if (ref) {
+        cm->clock_ref_bitmap[slot / 32] |= (uint32_t)1 << (slot % 32);
+    } else {
+        cm->clock_ref_bitmap[slot / 32] &= ~((uint32_t)1 << (slot % 32));
+    }
+}
+
+static cache_manager_node_t* cm_clock_peek(cache_manager_t* cm)
+{
+    /*One sweep clears every reference bit, a second one finds nothing but pinned nodes*/
+    uint32_t step_limit = cm->cache_num * 2;
+    uint32_t step = 0;
+
+    while (step < step_limit) {
+        uint32_t hand = cm->cache_tail;
+        uint32_t* word = &cm->clock_ref_bitmap[hand / 32];
+
+        /*A whole word of referenced nodes only gets its second chance*/
+        if (hand % 32 == 0 && hand + 32 <= cm->cache_num && *word == UINT32_MAX) {
+            *word = 0;
+            cm->cache_tail = (hand + 32) % cm->cache_num;
+            step += 32;
+            continue;
+        }
+
+        cache_manager_node_t* node = &(cm->cache_node_array[hand]);
+
+        if (node->id != CACHE_MANAGER_INVALIDATE_ID && node->priv.pin_cnt == 0) {
+            if (!(*word & ((uint32_t)1 << (hand % 32)))) {
+                return node;
+            }
+            cm_clock_set_ref(cm, hand, false);
+        }
+
+        cm->cache_tail = (hand + 1) % cm->cache_num;
+        step++;
+    }
+
+    return NULL;
+}
+
+static bool cm_policy_alloc(cache_manager_t* cm, cache_manager_mode_t mode)
+{
+    /*Only the arrays of mode are touched, the policy in use keeps working on failure*/
+    if (mode == CACHE_MANAGER_MODE_ARC && !cm_ghost_init(cm)) {
+        return false;
+    }
+
+    if (mode == CACHE_MANAGER_MODE_WTINYLFU && !cm_sketch_init(cm)) {
+        return false;
+    }
+
+    if (mode == CACHE_MANAGER_MODE_CLOCK
+        && !cm_resize_array((void**)&cm->clock_ref_bitmap, sizeof(uint32_t) * ((cm->cache_num + 31) / 32))) {
+        CM_LOG_ERROR("clock_ref_bitmap malloc failed");
+        return false;
+    }
+
+    if (cm_mode_use_heap(mode)
+        && !cm_resize_array((void**)&cm->heap_array, sizeof(uint32_t) * cm->cache_num)) {
+        CM_LOG_ERROR("heap_array malloc failed");
+        return false;
+    }
+
+    if (mode == CACHE_MANAGER_MODE_GDSF
+        && !cm_resize_array((void**)&cm->gdsf_priority_array, sizeof(uint64_t) * cm->cache_num)) {
+        CM_LOG_ERROR("gdsf_priority_array malloc failed");
+        return false;
+    }
+
+    if (mode == CACHE_MANAGER_MODE_LFU
+        && !cm_resize_array((void**)&cm->lfu_bucket_array, sizeof(cache_manager_lfu_bucket_t) * cm->cache_num)) {
+        CM_LOG_ERROR("lfu_bucket_array malloc failed");
+        return false;
+    }
+
+    return true;
+}
+
+static void cm_policy_reset(cache_manager_t* cm)
+{
+    cm_list_init(&cm->lru_list);
+    cm->heap_cnt = 0;
+
+    for (uint32_t i = 0; i < CACHE_MANAGER_SEG_NUM; i++) {
+        cm_list_init(&cm->seg_list[i]);
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_ARC) {
+        cm->arc_p = 0;
+        cm->arc_ghost_hit = CACHE_MANAGER_NODE_NONE;
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_CLOCK) {
+        memset(cm->clock_ref_bitmap, 0, sizeof(uint32_t) * ((cm->cache_num + 31) / 32));
+        cm->cache_tail = 0;
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_GDSF) {
+        cm->gdsf_age = 0;
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_LFU) {
+        cm_lfu_init(cm);
+    }
+}
+
+static bool cm_policy_init(cache_manager_t* cm)
+{
+    if (!cm_policy_alloc(cm, cm->mode)) {
+        return false;
+    }
+
+    cm_policy_reset(cm);
+    return true;
+}
+
+static void cm_policy_attach(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    node->priv.prev = node->priv.next = node->priv.pos = CACHE_MANAGER_NODE_NONE;
+
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_LRU:
+        cm_list_push_front(cm, &cm->lru_list, node);
+        break;
+
+    case CACHE_MANAGER_MODE_LIFE:
+        cm_set_node_life(cm, node, 0);
+        cm_heap_push(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_LFU:
+        cm_lfu_attach(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_GDSF:
+        cm->gdsf_priority_array[cm_node_get_slot(cm, node)] = cm_gdsf_calc_priority(cm, node);
+        cm_heap_push(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_ARC:
+        /*Ids remembered by a ghost list come back as frequent*/
+        node->priv.pos = (cm->arc_ghost_hit != CACHE_MANAGER_NODE_NONE) ? CACHE_MANAGER_ARC_T2 : CACHE_MANAGER_ARC_T1;
+        cm_list_push_front(cm, &cm->seg_list[node->priv.pos], node);
+        cm->arc_ghost_hit = CACHE_MANAGER_NODE_NONE;
+        break;
+
+    case CACHE_MANAGER_MODE_WTINYLFU:
+        cm_wtinylfu_attach(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_CLOCK:
+        /*New nodes start unreferenced, only a hit buys a second chance*/
+        cm_clock_set_ref(cm, cm_node_get_slot(cm, node), false);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void cm_policy_detach(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_LRU:
+        cm_list_remove(cm, &cm->lru_list, node);
+        break;
+
+    case CACHE_MANAGER_MODE_LIFE:
+    case CACHE_MANAGER_MODE_GDSF:
+        cm_heap_remove(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_LFU:
+        cm_lfu_unlink_node(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_ARC:
+    case CACHE_MANAGER_MODE_WTINYLFU:
+        cm_list_remove(cm, &cm->seg_list[node->priv.pos], node);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void cm_policy_touch(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_LRU:
+        cm_list_remove(cm, &cm->lru_list, node);
+        cm_list_push_front(cm, &cm->lru_list, node);
+        break;
+
+    case CACHE_MANAGER_MODE_LIFE: {
+        int64_t life = (int64_t)cm_get_node_life(cm, node) + (int64_t)node->priv.time_to_open * CACHE_MANAGER_LIFE_GAIN;
+
+        if (life > CACHE_MANAGER_LIFE_LIMIT) {
+            life = CACHE_MANAGER_LIFE_LIMIT;
+        }
+
+        cm_set_node_life(cm, node, (int32_t)life);
+
+        /*Pinned nodes are out of the heap until they are released*/
+        if (node->priv.pos != CACHE_MANAGER_NODE_NONE) {
+            cm_heap_sift_down(cm, node->priv.pos);
+        }
+        break;
+    }
+
+    case CACHE_MANAGER_MODE_LFU:
+        cm_lfu_touch(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_GDSF:
+        cm->gdsf_priority_array[cm_node_get_slot(cm, node)] = cm_gdsf_calc_priority(cm, node);
+
+        if (node->priv.pos != CACHE_MANAGER_NODE_NONE) {
+            cm_heap_sift_down(cm, node->priv.pos);
+        }
+        break;
+
+    case CACHE_MANAGER_MODE_ARC:
+        cm_seg_move_front(cm, node, CACHE_MANAGER_ARC_T2);
+        break;
+
+    case CACHE_MANAGER_MODE_WTINYLFU:
+        cm_wtinylfu_touch(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_CLOCK:
+        cm_clock_set_ref(cm, cm_node_get_slot(cm, node), true);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void cm_policy_admit(cache_manager_t* cm, int id)
+{
+    /*Called on a miss, before room is made for the new node*/
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_ARC:
+        cm_arc_admit(cm, id);
+        break;
+
+    case CACHE_MANAGER_MODE_WTINYLFU:
+        cm_sketch_increment(cm, id);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void cm_policy_evict(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    /*Called with the victim still resident, before it is closed*/
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_ARC:
+        cm_arc_evict(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_CLOCK:
+        /*The refilled slot gets a full revolution before it is looked at again*/
+        cm->cache_tail = (cm_node_get_slot(cm, node) + 1) % cm->cache_num;
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void cm_pin_node(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    if (node->priv.pin_cnt++ > 0) {
+        return;
+    }
+
+    cm->pin_node_cnt++;
+
+    if (cm_mode_use_heap(cm->mode)) {
+        cm_heap_remove(cm, node);
+    }
+}
+
+static void cm_unpin_node(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    if (--node->priv.pin_cnt > 0) {
+        return;
+    }
+
+    cm->pin_node_cnt--;
+
+    if (cm_mode_use_heap(cm->mode)) {
+        cm_heap_push(cm, node);
+    }
+}
+
+static cache_manager_timer_t* cm_timer_get(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    return &cm->timer_array[cm_node_get_slot(cm, node)];
+}
+
+static bool cm_node_is_expired(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    if (!node->priv.timed) {
+        return false;
+    }
+
+    /*Wrap-safe like cm_tick_elaps(): the deadline is behind now by less than half the range*/
+    return (int32_t)(cm->tick_get_cb() - cm_timer_get(cm, node)->expire_tick) >= 0;
+}
+
+static uint32_t cm_timer_get_bucket(cache_manager_t* cm, uint32_t expire_tick)
+{
+    /*Bucket of the level whose span covers the remaining time; the wheel always
+     *advances by one tick, so an overdue deadline goes to the next tick*/
+    uint32_t delta = expire_tick - cm->timer_tick;
+
+    if (delta == 0 || delta > INT32_MAX) {
+        expire_tick = cm->timer_tick + 1;
+        delta = 1;
+    }
+
+    for (uint32_t level = 0; level < CACHE_MANAGER_TIMER_LEVEL_NUM - 1; level++) {
+        if (delta < ((uint32_t)1 << (CACHE_MANAGER_TIMER_SLOT_BITS * (level + 1)))) {
+            uint32_t slot = (expire_tick >> (CACHE_MANAGER_TIMER_SLOT_BITS * level)) & (CACHE_MANAGER_TIMER_SLOT_NUM - 1);
+            return level * CACHE_MANAGER_TIMER_SLOT_NUM + slot;
+        }
+    }
+
+    /*Farther than the top level can tell apart: park it in the last slot it can
+     *reach, it is filed again when that slot is cascaded*/
+    uint32_t shift = CACHE_MANAGER_TIMER_SLOT_BITS * (CACHE_MANAGER_TIMER_LEVEL_NUM - 1);
+    uint32_t span = (uint32_t)1 << (shift + CACHE_MANAGER_TIMER_SLOT_BITS);
+
+    if (delta >= span) {
+        expire_tick = cm->timer_tick + span - 1;
+    }
+
+    return (CACHE_MANAGER_TIMER_LEVEL_NUM - 1) * CACHE_MANAGER_TIMER_SLOT_NUM
+        + ((expire_tick >> shift) & (CACHE_MANAGER_TIMER_SLOT_NUM - 1));
+}
+
+static void cm_timer_add(cache_manager_t* cm, cache_manager_node_t* node, uint32_t due_tick)
+{
+    uint32_t bucket = cm_timer_get_bucket(cm, due_tick);
+    cache_manager_list_t* list = &cm->timer_wheel[bucket];
+    uint32_t slot = cm_node_get_slot(cm, node);
+    cache_manager_timer_t* timer = &cm->timer_array[slot];
+
+    timer->bucket = bucket;
+    timer->prev = CACHE_MANAGER_NODE_NONE;
+    timer->next = list->head;
+    node->priv.timed = true;
+
+    if (list->head != CACHE_MANAGER_NODE_NONE) {
+        cm->timer_array[list->head].prev = slot;
+    } else {
+        list->tail = slot;
+    }
+
+    list->head = slot;
+    list->cnt++;
+    cm->timer_level_cnt[bucket / CACHE_MANAGER_TIMER_SLOT_NUM]++;
+    cm->timer_cnt++;
+}
+
+static void cm_timer_remove(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    if (!node->priv.timed) {
+        return;
+    }
+
+    cache_manager_timer_t* timer = cm_timer_get(cm, node);
+    cache_manager_list_t* list = &cm->timer_wheel[timer->bucket];
+
+    if (timer->prev != CACHE_MANAGER_NODE_NONE) {
+        cm->timer_array[timer->prev].next = timer->next;
+    } else {
+        list->head = timer->next;
+    }
+
+    if (timer->next != CACHE_MANAGER_NODE_NONE) {
+        cm->timer_array[timer->next].prev = timer->prev;
+    } else {
+        list->tail = timer->prev;
+    }
+
+    list->cnt--;
+    cm->timer_level_cnt[timer->bucket / CACHE_MANAGER_TIMER_SLOT_NUM]--;
+    cm->timer_cnt--;
+    node->priv.timed = false;
+}
+
+static bool cm_timer_init(cache_manager_t* cm)
+{
+    if (cm->timer_wheel) {
+        return true;
+    }
+
+    if (!cm->tick_get_cb) {
+        CM_LOG_ERROR("TTL needs tick_get_cb");
+        return false;
+    }
+
+    cm->timer_wheel = CACHE_MANAGER_MALLOC(sizeof(cache_manager_list_t) * CACHE_MANAGER_TIMER_BUCKET_NUM);
+    cm->timer_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_timer_t) * cm->cache_num);
+
+    if (!cm->timer_wheel || !cm->timer_array) {
+        CM_LOG_ERROR("timer malloc failed");
+
+        if (cm->timer_wheel) {
+            CACHE_MANAGER_FREE(cm->timer_wheel);
+            cm->timer_wheel = NULL;
+        }
+        if (cm->timer_array) {
+            CACHE_MANAGER_FREE(cm->timer_array);
+            cm->timer_array = NULL;
+        }
+        return false;
+    }
+
+    for (uint32_t i = 0; i < CACHE_MANAGER_TIMER_BUCKET_NUM; i++) {
+        cm_list_init(&cm->timer_wheel[i]);
+    }
+
+    cm->timer_tick = cm->tick_get_cb();
+    cm->timer_cnt = 0;
+    memset(cm->timer_level_cnt, 0, sizeof(cm->timer_level_cnt));
+    return true;
+}
+
+static void cm_timer_start(cache_manager_t* cm, cache_manager_node_t* node, uint32_t ttl)
+{
+    uint32_t expire_tick = cm->tick_get_cb() + ttl;
+
+    cm_timer_remove(cm, node);
+    cm_timer_get(cm, node)->expire_tick = expire_tick;
+    cm_timer_add(cm, node, expire_tick);
+}
+
+static void cm_attach_node(cache_manager_t* cm, cache_manager_node_t* node)
+{
+#if CACHE_MANAGER_USE_HASH
+    cm_index_insert(&cm->index, node->id, cm_node_get_slot(cm, node));
+#else
+    cm->id_array[cm_node_get_slot(cm, node)] = node->id;
+#endif
+    if (cm->key_array) {
+        cm_key_table_insert(cm, cm->key_array[cm_node_get_slot(cm, node)].hash, cm_node_get_slot(cm, node));
+    }
+    cm->cache_bytes += node->context.size;
+
+    if (cm->attach_tick_array) {
+        cm->attach_tick_array[cm_node_get_slot(cm, node)] = cm->tick_get_cb();
+    }
+
+    node->priv.timed = false;
+
+    if (cm->default_ttl > 0) {
+        cm_timer_start(cm, node, cm->default_ttl);
+    }
+
+    cm_policy_attach(cm, node);
+}
+
+static void cm_detach_node(cache_manager_t* cm, cache_manager_node_t* node)
+{
+#if CACHE_MANAGER_USE_HASH
+    cm_index_remove(&cm->index, node->id);
+#else
+    cm->id_array[cm_node_get_slot(cm, node)] = CACHE_MANAGER_INVALIDATE_ID;
+#endif
+    if (cm->key_array) {
+        cm_key_table_remove(cm, cm->key_array[cm_node_get_slot(cm, node)].hash, cm_node_get_slot(cm, node));
+    }
+    cm->cache_bytes -= node->context.size;
+
+    if (cm->attach_tick_array) {
+        cm_stats_record(cm->stats.lifetime_hist, cm_tick_elaps(cm, cm->attach_tick_array[cm_node_get_slot(cm, node)]));
+    }
+
+    cm_timer_remove(cm, node);
+    cm_policy_detach(cm, node);
+}
+
+static void cm_reset_free_slot(cache_manager_t* cm)
+{
+    /*Pushed in reverse order so that slots are handed out from index 0 upwards*/
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cm->free_slot_array[i] = cm->cache_num - 1 - i;
+    }
+    cm->free_slot_cnt = cm->cache_num;
+}
+
+static void cm_push_free_slot(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    cm->free_slot_array[cm->free_slot_cnt++] = cm_node_get_slot(cm, node);
+}
+
+static cache_manager_node_t* cm_pop_free_slot(cache_manager_t* cm)
+{
+    if (cm->free_slot_cnt == 0) {
+        return NULL;
+    }
+
+    cm->free_slot_cnt--;
+    return &(cm->cache_node_array[cm->free_slot_array[cm->free_slot_cnt]]);
+}
+
+static cache_manager_node_t* cm_find_empty_node(cache_manager_t* cm)
+{
+    return cm_pop_free_slot(cm);
+}
+
+/*Fills node without modifying cm, cm_load() runs it outside of the caller's lock.
+ *L2 is only looked up when l2_loaded_p is given, dropping its entry writes cm*/
+static bool cm_open_node(cache_manager_t* cm, cache_manager_node_t* node, int id, const cache_manager_node_t* recycled, bool* l2_loaded_p)
+{
+    uint32_t start_time = 0;
+    cache_manager_node_t node_tmp = { 0 };
+
+    if (recycled) {
+        /*create_cb takes over the victim's buffer, to reuse or to free*/
+        node_tmp.context = recycled->context;
+    }
+
+    CM_LOG_INFO("id:%d creating...", id);
+
+    if (cm->tick_get_cb) {
+        start_time = cm->tick_get_cb();
+    }
+
+    node_tmp.cache_manager = cm;
+    node_tmp.id = id;
+    bool success = false;
+
+    if (l2_loaded_p && cm->l2 && cm_l2_load(cm, &node_tmp)) {
+        /*The spilled payload is much cheaper than a rebuild*/
+        success = *l2_loaded_p = true;
+    } else {
+        success = cm->create_cb(&node_tmp);
+    }
+
+    if (cm->tick_get_cb) {
+        node_tmp.priv.time_to_open = cm_tick_elaps(cm, start_time);
+        CM_LOG_INFO("time cost: %" PRIu32, node_tmp.priv.time_to_open);
+    }
+
+    if (node_tmp.priv.time_to_open == 0) {
+        node_tmp.priv.time_to_open = 1;
+    }
+
+    if (success) {
+        *node = node_tmp;
+    } else {
+        CM_LOG_WARN("id:%d create failed", id);
+    }
+
+    return success;
+}
+
+/*What cm_open_node() did goes into cm here, with the caller's lock held*/
+static void cm_record_open(cache_manager_t* cm, const cache_manager_node_t* node, bool l2_loaded)
+{
+    if (l2_loaded) {
+        cm->stats.l2_hit_cnt++;
+    }
+
+    cm_stats_record(cm->stats.open_time_hist, node->priv.time_to_open);
+    cm_trace_event(cm, l2_loaded ? CACHE_MANAGER_TRACE_L2_LOAD : CACHE_MANAGER_TRACE_CREATE, node->id, node->priv.time_to_open);
+}
+
+static void cm_record_open_fail(cache_manager_t* cm, int id)
+{
+    cm->stats.create_fail_cnt++;
+    cm_trace_event(cm, CACHE_MANAGER_TRACE_CREATE_FAIL, id, 0);
+}
+
+static void cm_close_node(cache_manager_node_t* node)
+{
+    if (node->id == CACHE_MANAGER_INVALIDATE_ID) {
+        return;
+    }
+
+    cache_manager_t* cm = node->cache_manager;
+
+    cm_detach_node(cm, node);
+
+    if (cm->delete_cb) {
+        cm->delete_cb(node);
+    }
+
+    CM_LOG_INFO("id:%d closed, ref_cnt = %" PRIu32, node->id, node->priv.ref_cnt);
+
+    if (cm->key_array) {
+        cm_key_deinit(&cm->key_array[cm_node_get_slot(cm, node)]);
+    }
+    memset(node, 0, sizeof(cache_manager_node_t));
+}
+
+static void cm_drop_node(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    /*Release the context of a node which never made it into the array*/
+    if (cm->delete_cb) {
+        cm->delete_cb(node);
+    }
+
+    cm_key_drop_staged(cm);
+}
+
+static void cm_inc_node_ref_cnt(cache_manager_node_t* node)
+{
+#if CACHE_MANAGER_REF_CNT_LIMIT
+    if (node->priv.ref_cnt < CACHE_MANAGER_REF_CNT_LIMIT) {
+        node->priv.ref_cnt++;
+    }
+#else
+    if (node->priv.ref_cnt < UINT32_MAX) {
+        node->priv.ref_cnt++;
+    }
+#endif
+}
+
+static cache_manager_node_t* cm_find_reuse_lfu(cache_manager_t* cm)
+{
+    return cm_lfu_peek(cm);
+}
+
+static cache_manager_node_t* cm_find_reuse_random(cache_manager_t* cm)
+{
+    uint32_t index = CACHE_MANAGER_RAND() % cm->cache_num;
+
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cache_manager_node_t* node = &(cm->cache_node_array[index]);
+
+        if (node->id != CACHE_MANAGER_INVALIDATE_ID && node->priv.pin_cnt == 0) {
+            return node;
+        }
+
+        index = (index + 1) % cm->cache_num;
+    }
+
+    return NULL;
+}
+
+static cache_manager_node_t* cm_find_reuse_lru(cache_manager_t* cm)
+{
+    /*The least recently used entry sits at the tail of the recency list*/
+    return cm_list_peek_unpinned(cm, &cm->lru_list);
+}
+
+static cache_manager_node_t* cm_find_reuse_life(cache_manager_t* cm)
+{
+    /*Select the entry with the least life, kept at the top of the heap*/
+    return cm_heap_peek(cm);
+}
+
+static cache_manager_node_t* cm_find_reuse_gdsf(cache_manager_t* cm)
+{
+    cache_manager_node_t* node = cm_heap_peek(cm);
+
+    if (node) {
+        /*Inflate the priority of future entries with the victim's one*/
+        cm->gdsf_age = cm->gdsf_priority_array[cm_node_get_slot(cm, node)];
+    }
+
+    return node;
+}
+
+static cache_manager_node_t* cm_node_fifo_peek(cache_manager_t* cm)
+{
+    if (cm->cache_head == cm->cache_tail) {
+        return NULL;
+    }
+
+    return &(cm->cache_node_array[cm->cache_tail]);
+}
+
+static cache_manager_node_t* cm_node_fifo_pop(cache_manager_t* cm)
+{
+    cache_manager_node_t* node = cm_node_fifo_peek(cm);
+    if (!node) {
+        return NULL;
+    }
+
+    cm->cache_tail = (cm->cache_tail + 1) % cm->cache_num;
+    return node;
+}
+
+static void cm_node_fifo_push(cache_manager_t* cm)
+{
+    uint32_t index = (uint32_t)(cm->cache_head + 1) % cm->cache_num;
+    if (index != cm->cache_tail) {
+        cm->cache_head = index;
+    }
+}
+
+static bool cm_fifo_reclaim(cache_manager_t* cm)
+{
+    /*A tombstone reached by the tail frees its slot like an evicted victim*/
+    cache_manager_node_t* node = cm_get_node(cm, cm->cache_tail);
+
+    if (cm->tombstone_cnt == 0 || node->id != CACHE_MANAGER_INVALIDATE_ID
+        || node->priv.pos != CACHE_MANAGER_FIFO_TOMBSTONE) {
+        return false;
+    }
+
+    node->priv.pos = 0;
+    cm->tombstone_cnt--;
+    cm_push_free_slot(cm, node);
+    cm_node_fifo_pop(cm);
+    cm_node_fifo_push(cm);
+    return true;
+}
+
+static cache_manager_node_t* cm_find_reuse_fifo(cache_manager_t* cm)
+{
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cache_manager_node_t* node = cm_node_fifo_peek(cm);
+
+        if (!node || (node->id != CACHE_MANAGER_INVALIDATE_ID && node->priv.pin_cnt == 0)) {
+            return node;
+        }
+
+        /*Rotate pinned nodes and slots freed by byte evictions to the back*/
+        cm_node_fifo_pop(cm);
+        cm_node_fifo_push(cm);
+    }
+
+    return NULL;
+}
+
+static cache_manager_node_t* cm_find_reuse_node(cache_manager_t* cm)
+{
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_LFU:
+        return cm_find_reuse_lfu(cm);
+
+    case CACHE_MANAGER_MODE_RANDOM:
+        return cm_find_reuse_random(cm);
+
+    case CACHE_MANAGER_MODE_LIFE:
+        return cm_find_reuse_life(cm);
+
+    case CACHE_MANAGER_MODE_LRU:
+        return cm_find_reuse_lru(cm);
+
+    case CACHE_MANAGER_MODE_FIFO:
+        return cm_find_reuse_fifo(cm);
+
+    case CACHE_MANAGER_MODE_GDSF:
+        return cm_find_reuse_gdsf(cm);
+
+    case CACHE_MANAGER_MODE_ARC:
+        return cm_arc_peek(cm);
+
+    case CACHE_MANAGER_MODE_WTINYLFU:
+        return cm_wtinylfu_peek(cm);
+
+    case CACHE_MANAGER_MODE_CLOCK:
+        return cm_clock_peek(cm);
+
+    default:
+        CM_LOG_ERROR("unsupport cache mode: %d", cm->mode);
+        break;
+    }
+
+    return NULL;
+}
+
+static uint32_t cm_get_resident_num(cache_manager_t* cm)
+{
+    return cm->cache_num - cm->free_slot_cnt - cm->tombstone_cnt;
+}
+
+static bool cm_over_byte_limit(cache_manager_t* cm, uint32_t size)
+{
+    return cm->byte_limit > 0 && cm->cache_bytes + size > cm->byte_limit;
+}
+
+static bool cm_fifo_compact(cache_manager_t* cm, uint32_t ring_num);
+static void cm_rebuild_free_slot(cache_manager_t* cm);
+
+static bool cm_fifo_collect(cache_manager_t* cm)
+{
+    /*Compacting costs a pass over the ring and moves nodes, so it waits for
+     *enough tombstones and for no pointer to be pinned. It only runs when a
+     *victim is due anyway, unpinned pointers don't outlive a miss*/
+    if (cm->pin_node_cnt > 0 || cm->tombstone_cnt <= cm->cache_num / CACHE_MANAGER_FIFO_TOMBSTONE_DIV) {
+        return false;
+    }
+
+    if (!cm_fifo_compact(cm, cm->cache_num)) {
+        return false;
+    }
+
+    cm_rebuild_free_slot(cm);
+    return true;
+}
+
+static cache_manager_res_t cm_evict_node(cache_manager_t* cm, cache_manager_node_t* recycled)
+{
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO && (cm_fifo_collect(cm) || cm_fifo_reclaim(cm))) {
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    cache_manager_node_t* node = cm_find_reuse_node(cm);
+
+    if (!node) {
+        CM_LOG_WARN("can't find reuse node, all nodes are pinned");
+        return CACHE_MANAGER_RES_ERR_PINNED;
+    }
+
+    CM_LOG_INFO("id:%d evicted", node->id);
+    cm->stats.evict_cnt++;
+    cm_trace_event(cm, CACHE_MANAGER_TRACE_EVICT, node->id, 0);
+
+    /*Nodes with a TTL would outlive it in L2*/
+    if (cm->l2 && !node->priv.timed && cm_l2_spill(cm, node)) {
+        cm->stats.l2_spill_cnt++;
+    }
+
+    cm_policy_evict(cm, node);
+
+    if (recycled) {
+        /*Keep the context for the next create_cb instead of deleting it*/
+        recycled->context = node->context;
+        cm_detach_node(cm, node);
+        if (cm->key_array) {
+            cm_key_deinit(&cm->key_array[cm_node_get_slot(cm, node)]);
+        }
+        memset(node, 0, sizeof(cache_manager_node_t));
+    } else {
+        cm_close_node(node);
+    }
+
+    cm_push_free_slot(cm, node);
+
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        cm_node_fifo_pop(cm);
+        cm_node_fifo_push(cm);
+    }
+
+    return CACHE_MANAGER_RES_OK;
+}
+
+static void cm_open_many_batch(cache_manager_t* cm, cache_manager_node_t* node_array, bool* success_array, uint32_t num);
+
+static void cm_open_many_create(cache_manager_t* cm, cache_manager_node_t* node_array, bool* success_array, uint32_t num)
+{
+    if (!cm->batch_create_cb) {
+        for (uint32_t i = 0; i < num; i++) {
+            bool l2_loaded = false;
+            success_array[i] = cm_open_node(cm, &node_array[i], node_array[i].id, NULL, &l2_loaded);
+
+            if (success_array[i]) {
+                cm_record_open(cm, &node_array[i], l2_loaded);
+            } else {
+                cm_record_open_fail(cm, node_array[i].id);
+            }
+        }
+        return;
+    }
+
+    if (cm->l2) {
+        /*Payloads found in L2 split the batch into runs of real misses*/
+        uint32_t start = 0;
+
+        for (uint32_t i = 0; i < num; i++) {
+            uint32_t start_time = cm->tick_get_cb ? cm->tick_get_cb() : 0;
+            success_array[i] = false;
+
+            if (cm_l2_load(cm, &node_array[i])) {
+                uint32_t time_to_open = cm->tick_get_cb ? cm_tick_elaps(cm, start_time) : 0;
+
+                node_array[i].priv.time_to_open = time_to_open > 0 ? time_to_open : 1;
+                success_array[i] = true;
+                cm_record_open(cm, &node_array[i], true);
+                cm_open_many_batch(cm, node_array + start, success_array + start, i - start);
+                start = i + 1;
+            }
+        }
+
+        cm_open_many_batch(cm, node_array + start, success_array + start, num - start);
+        return;
+    }
+
+    cm_open_many_batch(cm, node_array, success_array, num);
+}
+
+static void cm_open_many_batch(cache_manager_t* cm, cache_manager_node_t* node_array, bool* success_array, uint32_t num)
+{
+    uint32_t start_time = 0;
+
+    if (num == 0) {
+        return;
+    }
+
+    CM_LOG_INFO("creating %" PRIu32 " nodes in one batch...", num);
+
+    if (cm->tick_get_cb) {
+        start_time = cm->tick_get_cb();
+    }
+
+    cm->batch_create_cb(node_array, success_array, num);
+
+    /*The loader shares its work across the batch, so is the cost*/
+    uint32_t time_to_open = cm->tick_get_cb ? cm_tick_elaps(cm, start_time) / num : 0;
+
+    for (uint32_t i = 0; i < num; i++) {
+        node_array[i].priv.time_to_open = time_to_open > 0 ? time_to_open : 1;
+
+        if (success_array[i]) {
+            cm_record_open(cm, &node_array[i], false);
+        } else {
+            CM_LOG_WARN("id:%d create failed", node_array[i].id);
+            cm_record_open_fail(cm, node_array[i].id);
+        }
+    }
+}
+
+static uint32_t cm_order_add_list(cache_manager_t* cm, const cache_manager_list_t* list, uint32_t* slot_array, uint32_t cnt)
+{
+    /*From the tail, the end the policy evicts from*/
+    for (uint32_t slot = list->tail; slot != CACHE_MANAGER_NODE_NONE; slot = cm_get_node(cm, slot)->priv.prev) {
+        slot_array[cnt++] = slot;
+    }
+
+    return cnt;
+}
+
+static void cm_order_sift_down(cache_manager_t* cm, uint32_t* slot_array, uint32_t pos, uint32_t cnt)
+{
+    uint32_t slot = slot_array[pos];
+
+    while (true) {
+        uint32_t child = pos * 2 + 1;
+        if (child >= cnt) {
+            break;
+        }
+        if (child + 1 < cnt && cm_heap_less(cm, slot_array[child + 1], slot_array[child])) {
+            child++;
+        }
+        if (!cm_heap_less(cm, slot_array[child], slot)) {
+            break;
+        }
+        slot_array[pos] = slot_array[child];
+        pos = child;
+    }
+
+    slot_array[pos] = slot;
+}
+
+static uint32_t cm_order_add_heap(cache_manager_t* cm, uint32_t* slot_array)
+{
+    /*Heap sort a copy of the heap, the min-heap leaves it in descending order*/
+    uint32_t cnt = cm->heap_cnt;
+    memcpy(slot_array, cm->heap_array, sizeof(uint32_t) * cnt);
+
+    for (uint32_t end = cnt; end > 1; end--) {
+        uint32_t min = slot_array[0];
+        slot_array[0] = slot_array[end - 1];
+        slot_array[end - 1] = min;
+        cm_order_sift_down(cm, slot_array, 0, end - 1);
+    }
+
+    for (uint32_t i = 0; i < cnt / 2; i++) {
+        uint32_t tmp = slot_array[i];
+        slot_array[i] = slot_array[cnt - 1 - i];
+        slot_array[cnt - 1 - i] = tmp;
+    }
+
+    /*Pinned nodes are out of the heap, they are the last to go*/
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cache_manager_node_t* node = cm_get_node(cm, i);
+        if (node->id != CACHE_MANAGER_INVALIDATE_ID && node->priv.pos == CACHE_MANAGER_NODE_NONE) {
+            slot_array[cnt++] = i;
+        }
+    }
+
+    return cnt;
+}
+
+static uint32_t cm_order_add_ring(cache_manager_t* cm, uint32_t* slot_array, bool use_ref)
+{
+    /*From the FIFO tail or the CLOCK hand, unreferenced nodes first for CLOCK*/
+    uint32_t cnt = 0;
+
+    for (uint32_t pass = 0; pass < (use_ref ? 2 : 1); pass++) {
+        for (uint32_t i = 0; i < cm->cache_num; i++) {
+            uint32_t slot = (cm->cache_tail + i) % cm->cache_num;
+
+            if (cm_get_node(cm, slot)->id == CACHE_MANAGER_INVALIDATE_ID) {
+                continue;
+            }
+
+            if (use_ref) {
+                bool ref = (cm->clock_ref_bitmap[slot / 32] >> (slot % 32)) & 1;
+                if (ref != (pass == 1)) {
+                    continue;
+                }
+            }
+
+            slot_array[cnt++] = slot;
+        }
+    }
+
+    return cnt;
+}
+
+static void cm_policy_restore(cache_manager_t* cm, cache_manager_node_t* node, const cache_manager_node_t* state)
+{
+    /*Restored nodes come in from the hottest, each one is colder than the ones
+     *before, so they go to the cold end of the structure they were attached to*/
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_LRU:
+        cm_list_remove(cm, &cm->lru_list, node);
+        cm_list_push_back(cm, &cm->lru_list, node);
+        break;
+
+    case CACHE_MANAGER_MODE_LIFE:
+        cm_heap_remove(cm, node);
+        cm_set_node_life(cm, node, state->priv.life);
+        cm_heap_push(cm, node);
+        break;
+
+    case CACHE_MANAGER_MODE_LFU: {
+        /*ref_cnt stands for the frequency above the current age*/
+        uint32_t freq = cm->lfu_age + node->priv.ref_cnt;
+        uint32_t prev = CACHE_MANAGER_NODE_NONE;
+
+        if (freq < cm->lfu_age) {
+            freq = UINT32_MAX;
+        }
+
+        cm_lfu_unlink_node(cm, node);
+
+        for (uint32_t index = cm->lfu_bucket_head; index != CACHE_MANAGER_NODE_NONE; index = cm_lfu_get_bucket(cm, index)->next) {
+            if (cm_lfu_get_bucket(cm, index)->freq >= freq) {
+                break;
+            }
+            prev = index;
+        }
+
+        cm_lfu_link_node(cm, node, prev, freq);
+        cache_manager_list_t* list = &cm_lfu_get_bucket(cm, node->priv.pos)->list;
+        cm_list_remove(cm, list, node);
+        cm_list_push_back(cm, list, node);
+        break;
+    }
+
+    case CACHE_MANAGER_MODE_ARC:
+        /*Entries that were hit again belong to the frequency side*/
+        cm_seg_move_back(cm, node, node->priv.ref_cnt > 1 ? CACHE_MANAGER_ARC_T2 : node->priv.pos);
+        break;
+
+    case CACHE_MANAGER_MODE_WTINYLFU: {
+        uint32_t main_max = cm->cache_num - cm_wtinylfu_get_window_max(cm);
+        uint32_t protected_cnt = cm->seg_list[CACHE_MANAGER_WTINYLFU_PROTECTED].cnt;
+        uint32_t main_cnt = cm->seg_list[CACHE_MANAGER_WTINYLFU_PROBATION].cnt + protected_cnt;
+        uint32_t seg = node->priv.pos;
+
+        if (node->priv.pos == CACHE_MANAGER_WTINYLFU_WINDOW && main_cnt < main_max) {
+            seg = (node->priv.ref_cnt > 1 && protected_cnt < main_max * CACHE_MANAGER_WTINYLFU_PROTECTED_PERCENT / 100)
+                ? CACHE_MANAGER_WTINYLFU_PROTECTED
+                : CACHE_MANAGER_WTINYLFU_PROBATION;
+        }
+
+        cm_seg_move_back(cm, node, seg);
+
+        /*Give the sketch the popularity the id had, for the admission checks*/
+        for (uint32_t i = 1; i < node->priv.ref_cnt && i < 16; i++) {
+            cm_sketch_increment(cm, node->id);
+        }
+        break;
+    }
+
+    case CACHE_MANAGER_MODE_CLOCK:
+        cm_clock_set_ref(cm, cm_node_get_slot(cm, node), node->priv.ref_cnt > 1);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void cm_expire_node(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    CM_LOG_INFO("id:%d expired", node->id);
+    cm_trace_event(cm, CACHE_MANAGER_TRACE_EXPIRE, node->id, 0);
+    cm_close_node(node);
+    cm_push_free_slot(cm, node);
+    cm->stats.expire_cnt++;
+}
+
+static uint32_t cm_timer_run_bucket(cache_manager_t* cm, uint32_t bucket)
+{
+    /*Expire what is due, file the rest again in a lower level*/
+    cache_manager_list_t* list = &cm->timer_wheel[bucket];
+    uint32_t expire_cnt = 0;
+
+    while (list->head != CACHE_MANAGER_NODE_NONE) {
+        cache_manager_node_t* node = cm_get_node(cm, list->head);
+        uint32_t expire_tick = cm->timer_array[list->head].expire_tick;
+        bool expired = (int32_t)(cm->timer_tick - expire_tick) >= 0;
+
+        cm_timer_remove(cm, node);
+
+        if (!expired) {
+            cm_timer_add(cm, node, expire_tick);
+        } else if (node->priv.pin_cnt > 0) {
+            /*Pinned nodes can't go yet, look again one turn of the first level later*/
+            cm_timer_add(cm, node, cm->timer_tick + CACHE_MANAGER_TIMER_SLOT_NUM);
+        } else {
+            cm_expire_node(cm, node);
+            expire_cnt++;
+        }
+    }
+
+    return expire_cnt;
+}
+
+static uint32_t cm_timer_advance(cache_manager_t* cm)
+{
+    uint32_t now = cm->tick_get_cb();
+    uint32_t expire_cnt = 0;
+
+    if ((int32_t)(now - cm->timer_tick) <= 0) {
+        return 0;
+    }
+
+    while (cm->timer_tick != now) {
+        if (cm->timer_cnt == 0) {
+            /*Nothing to expire, catch up at once*/
+            cm->timer_tick = now;
+            break;
+        }
+
+        uint32_t level = 0;
+        while (cm->timer_level_cnt[level] == 0) {
+            level++;
+        }
+
+        if (level > 0) {
+            /*The levels below are empty, skip to the tick before the next cascade*/
+            uint32_t shift = CACHE_MANAGER_TIMER_SLOT_BITS * level;
+            uint32_t skip_tick = (((cm->timer_tick >> shift) + 1) << shift) - 1;
+
+            if (skip_tick - cm->timer_tick >= now - cm->timer_tick) {
+                cm->timer_tick = now;
+                break;
+            }
+
+            cm->timer_tick = skip_tick;
+        }
+
+        cm->timer_tick++;
+
+        /*At each wrap of a level, hand the next slot of the level above down,
+         *from the top so that entries fall through several levels at once*/
+        level = 0;
+        while (level < CACHE_MANAGER_TIMER_LEVEL_NUM - 1
+            && ((cm->timer_tick >> (CACHE_MANAGER_TIMER_SLOT_BITS * level)) & (CACHE_MANAGER_TIMER_SLOT_NUM - 1)) == 0) {
+            level++;
+        }
+
+        for (; level > 0; level--) {
+            uint32_t slot = (cm->timer_tick >> (CACHE_MANAGER_TIMER_SLOT_BITS * level)) & (CACHE_MANAGER_TIMER_SLOT_NUM - 1);
+            expire_cnt += cm_timer_run_bucket(cm, level * CACHE_MANAGER_TIMER_SLOT_NUM + slot);
+        }
+
+        expire_cnt += cm_timer_run_bucket(cm, cm->timer_tick & (CACHE_MANAGER_TIMER_SLOT_NUM - 1));
+    }
+
+    return expire_cnt;
+}
+
+static cache_manager_node_t* cm_find_live_node(cache_manager_t* cm, int id)
+{
+    cache_manager_node_t* node = cm_find_node(cm, id);
+
+    if (node && node->priv.pin_cnt == 0 && cm_node_is_expired(cm, node)) {
+        /*A stale entry is a miss, it is reloaded by the caller*/
+        cm_expire_node(cm, node);
+        return NULL;
+    }
+
+    return node;
+}
+
+static cache_manager_node_t* cm_find_live_key_node(cache_manager_t* cm, const void* key, uint32_t len, uint32_t hash)
+{
+    uint32_t slot = cm_key_table_find(cm, key, len, hash);
+
+    if (slot == CACHE_MANAGER_NODE_NONE) {
+        return NULL;
+    }
+
+    cache_manager_node_t* node = cm_get_node(cm, slot);
+
+    if (node->priv.pin_cnt == 0 && cm_node_is_expired(cm, node)) {
+        cm_expire_node(cm, node);
+        return NULL;
+    }
+
+    return node;
+}
+
+static cache_manager_list_t* cm_policy_get_list(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_LRU:
+        return &cm->lru_list;
+
+    case CACHE_MANAGER_MODE_LFU:
+        return &cm_lfu_get_bucket(cm, node->priv.pos)->list;
+
+    case CACHE_MANAGER_MODE_ARC:
+    case CACHE_MANAGER_MODE_WTINYLFU:
+        return &cm->seg_list[node->priv.pos];
+
+    default:
+        break;
+    }
+
+    return NULL;
+}
+
+static void cm_move_node(cache_manager_t* cm, uint32_t from, uint32_t to)
+{
+    /*Relocate a resident node, every policy structure refers to it by slot*/
+    cache_manager_node_t* src = cm_get_node(cm, from);
+    cache_manager_node_t* dst = cm_get_node(cm, to);
+    cache_manager_list_t* list = cm_policy_get_list(cm, src);
+
+    *dst = *src;
+
+    if (list) {
+        if (dst->priv.prev != CACHE_MANAGER_NODE_NONE) {
+            cm_get_node(cm, dst->priv.prev)->priv.next = to;
+        } else {
+            list->head = to;
+        }
+
+        if (dst->priv.next != CACHE_MANAGER_NODE_NONE) {
+            cm_get_node(cm, dst->priv.next)->priv.prev = to;
+        } else {
+            list->tail = to;
+        }
+    }
+
+    if (cm_mode_use_heap(cm->mode) && dst->priv.pos != CACHE_MANAGER_NODE_NONE) {
+        cm->heap_array[dst->priv.pos] = to;
+    }
+
+    if (dst->priv.timed) {
+        cache_manager_timer_t* timer = &cm->timer_array[to];
+        cache_manager_list_t* timer_list = &cm->timer_wheel[cm->timer_array[from].bucket];
+
+        *timer = cm->timer_array[from];
+
+        if (timer->prev != CACHE_MANAGER_NODE_NONE) {
+            cm->timer_array[timer->prev].next = to;
+        } else {
+            timer_list->head = to;
+        }
+
+        if (timer->next != CACHE_MANAGER_NODE_NONE) {
+            cm->timer_array[timer->next].prev = to;
+        } else {
+            timer_list->tail = to;
+        }
+    }
+
+    if (cm->attach_tick_array) {
+        cm->attach_tick_array[to] = cm->attach_tick_array[from];
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_GDSF) {
+        cm->gdsf_priority_array[to] = cm->gdsf_priority_array[from];
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_CLOCK) {
+        cm_clock_set_ref(cm, to, cm->clock_ref_bitmap[from / 32] & ((uint32_t)1 << (from % 32)));
+        cm_clock_set_ref(cm, from, false);
+    }
+
+#if CACHE_MANAGER_USE_HASH
+    cm_index_remove(&cm->index, dst->id);
+    cm_index_insert(&cm->index, dst->id, to);
+#else
+    cm->id_array[to] = dst->id;
+    cm->id_array[from] = CACHE_MANAGER_INVALIDATE_ID;
+#endif
+
+    if (cm->key_array) {
+        cm->key_table[cm_key_table_find_slot(cm, cm->key_array[from].hash, from)].slot = to;
+        cm->key_array[to] = cm->key_array[from];
+        cm->key_array[from].len = 0;
+    }
+
+    memset(src, 0, sizeof(cache_manager_node_t));
+}
+
+static cache_manager_node_t* cm_alloc_move_array(cache_manager_t* cm, uint32_t num)
+{
+    /*Scratch to lay nodes out again: num nodes, then their keys in key mode,
+     *then their attach ticks. FIFO has no TTLs, so there are no timers to carry*/
+    size_t size = sizeof(cache_manager_node_t) + (cm->key_array ? sizeof(cache_manager_key_t) : 0)
+        + (cm->attach_tick_array ? sizeof(uint32_t) : 0);
+    return CACHE_MANAGER_MALLOC(size * num);
+}
+
+static void cm_move_out(cache_manager_t* cm, uint32_t slot, cache_manager_node_t* tmp_array, uint32_t tmp_num, uint32_t index)
+{
+    cache_manager_node_t* node = cm_get_node(cm, slot);
+#if CACHE_MANAGER_USE_HASH
+    cm_index_remove(&cm->index, node->id);
+#else
+    cm->id_array[slot] = CACHE_MANAGER_INVALIDATE_ID;
+#endif
+    if (cm->key_array) {
+        cache_manager_key_t* tmp_key_array = (cache_manager_key_t*)(tmp_array + tmp_num);
+
+        cm_key_table_remove(cm, cm->key_array[slot].hash, slot);
+        tmp_key_array[index] = cm->key_array[slot];
+        cm->key_array[slot].len = 0;
+    }
+    if (cm->attach_tick_array) {
+        uint32_t* tmp_tick_array = (uint32_t*)((cache_manager_key_t*)(tmp_array + tmp_num) + (cm->key_array ? tmp_num : 0));
+
+        tmp_tick_array[index] = cm->attach_tick_array[slot];
+    }
+    tmp_array[index] = *node;
+    memset(node, 0, sizeof(cache_manager_node_t));
+}
+
+static void cm_move_in(cache_manager_t* cm, const cache_manager_node_t* tmp_array, uint32_t tmp_num, uint32_t slot)
+{
+    cm->cache_node_array[slot] = tmp_array[slot];
+#if CACHE_MANAGER_USE_HASH
+    cm_index_insert(&cm->index, tmp_array[slot].id, slot);
+#else
+    cm->id_array[slot] = tmp_array[slot].id;
+#endif
+    if (cm->key_array) {
+        cm->key_array[slot] = ((const cache_manager_key_t*)(tmp_array + tmp_num))[slot];
+        cm_key_table_insert(cm, cm->key_array[slot].hash, slot);
+    }
+    if (cm->attach_tick_array) {
+        const uint32_t* tmp_tick_array = (const uint32_t*)((const cache_manager_key_t*)(tmp_array + tmp_num) + (cm->key_array ? tmp_num : 0));
+
+        cm->attach_tick_array[slot] = tmp_tick_array[slot];
+    }
+}
+
+static bool cm_fifo_compact(cache_manager_t* cm, uint32_t ring_num)
+{
+    /*The FIFO order is the ring order of the slots: move the residents to
+     *0..n-1 from the oldest one, as if they had been inserted in a new ring*/
+    uint32_t resident_num = ring_num - cm->free_slot_cnt - cm->tombstone_cnt;
+    uint32_t tail = cm->cache_tail;
+    uint32_t index = 0;
+
+    if (resident_num == 0) {
+        cm->cache_head = cm->cache_tail = 0;
+        return true;
+    }
+
+    cache_manager_node_t* tmp_array = cm_alloc_move_array(cm, resident_num);
+
+    if (!tmp_array) {
+        CM_LOG_ERROR("fifo tmp_array malloc failed");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < ring_num; i++) {
+        uint32_t slot = (tail + i) % ring_num;
+
+        if (cm_get_node(cm, slot)->id != CACHE_MANAGER_INVALIDATE_ID) {
+            cm_move_out(cm, slot, tmp_array, resident_num, index++);
+        }
+    }
+
+    for (uint32_t i = 0; i < resident_num; i++) {
+        cm_move_in(cm, tmp_array, resident_num, i);
+    }
+
+    CACHE_MANAGER_FREE(tmp_array);
+
+    cm->cache_tail = 0;
+    cm->cache_head = resident_num;
+    return true;
+}
+
+static bool cm_lfu_resize(cache_manager_t* cm, uint32_t cache_num)
+{
+    /*Copy the buckets in frequency order to the front of a new pool*/
+    cache_manager_lfu_bucket_t* bucket_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_lfu_bucket_t) * cache_num);
+
+    if (!bucket_array) {
+        CM_LOG_ERROR("lfu_bucket_array malloc failed");
+        return false;
+    }
+
+    uint32_t bucket_num = 0;
+
+    for (uint32_t index = cm->lfu_bucket_head; index != CACHE_MANAGER_NODE_NONE; index = cm_lfu_get_bucket(cm, index)->next) {
+        cache_manager_lfu_bucket_t* bucket = &bucket_array[bucket_num];
+        *bucket = *cm_lfu_get_bucket(cm, index);
+        bucket->prev = bucket_num > 0 ? bucket_num - 1 : CACHE_MANAGER_NODE_NONE;
+        bucket->next = bucket_num + 1;
+
+        for (uint32_t slot = bucket->list.head; slot != CACHE_MANAGER_NODE_NONE; slot = cm_get_node(cm, slot)->priv.next) {
+            cm_get_node(cm, slot)->priv.pos = bucket_num;
+        }
+
+        bucket_num++;
+    }
+
+    if (bucket_num > 0) {
+        bucket_array[bucket_num - 1].next = CACHE_MANAGER_NODE_NONE;
+    }
+
+    for (uint32_t i = bucket_num; i < cache_num; i++) {
+        bucket_array[i].next = (i + 1 < cache_num) ? i + 1 : CACHE_MANAGER_NODE_NONE;
+    }
+
+    CACHE_MANAGER_FREE(cm->lfu_bucket_array);
+    cm->lfu_bucket_array = bucket_array;
+    cm->lfu_bucket_head = bucket_num > 0 ? 0 : CACHE_MANAGER_NODE_NONE;
+    cm->lfu_bucket_free = bucket_num < cache_num ? bucket_num : CACHE_MANAGER_NODE_NONE;
+    return true;
+}
+
+static bool cm_resize_policy_arrays(cache_manager_t* cm, uint32_t cache_num)
+{
+    bool success = cm_resize_array((void**)&cm->cache_node_array, sizeof(cache_manager_node_t) * cache_num)
+        && cm_resize_array((void**)&cm->free_slot_array, sizeof(uint32_t) * cache_num);
+
+#if !CACHE_MANAGER_USE_HASH
+    success = success && cm_resize_array((void**)&cm->id_array, sizeof(int) * cache_num);
+#endif
+
+    if (cm_mode_use_heap(cm->mode)) {
+        success = success && cm_resize_array((void**)&cm->heap_array, sizeof(uint32_t) * cache_num);
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_GDSF) {
+        success = success && cm_resize_array((void**)&cm->gdsf_priority_array, sizeof(uint64_t) * cache_num);
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_CLOCK) {
+        success = success && cm_resize_array((void**)&cm->clock_ref_bitmap, sizeof(uint32_t) * ((cache_num + 31) / 32));
+    }
+
+    if (cm->key_array) {
+        success = success && cm_resize_array((void**)&cm->key_array, sizeof(cache_manager_key_t) * (cache_num + 1));
+    }
+
+    if (cm->attach_tick_array) {
+        success = success && cm_resize_array((void**)&cm->attach_tick_array, sizeof(uint32_t) * cache_num);
+    }
+
+    if (cm->timer_array) {
+        success = success && cm_resize_array((void**)&cm->timer_array, sizeof(cache_manager_timer_t) * cache_num);
+    }
+
+    return success;
+}
+
+static void cm_rebuild_free_slot(cache_manager_t* cm)
+{
+    /*Empty slots are pushed from the top, so the lowest ones come out first,
+     *tombstones of the FIFO ring become free slots like the others*/
+    cm->free_slot_cnt = 0;
+    cm->tombstone_cnt = 0;
+
+    for (uint32_t i = cm->cache_num; i > 0; i--) {
+        cache_manager_node_t* node = cm_get_node(cm, i - 1);
+
+        if (node->id == CACHE_MANAGER_INVALIDATE_ID) {
+            node->priv.pos = 0;
+            cm->free_slot_array[cm->free_slot_cnt++] = i - 1;
+        }
+    }
+}
+
+static bool cm_resize_key_table(cache_manager_t* cm)
+{
+    if (!cm->key_table || cm_index_get_size(cm->cache_num) == cm->key_mask + 1) {
+        return true;
+    }
+
+    if (!cm_key_table_init(cm)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        if (cm->key_array[i].len > 0) {
+            cm_key_table_insert(cm, cm->key_array[i].hash, i);
+        }
+    }
+
+    return true;
+}
+
+static bool cm_resize_index(cache_manager_t* cm)
+{
+    if (!cm_resize_key_table(cm)) {
+        return false;
+    }
+
+#if CACHE_MANAGER_USE_HASH
+    /*Moved nodes were updated one by one, only a new table size needs a rehash*/
+    if (cm_index_get_size(cm->cache_num) == cm->index.mask + 1) {
+        return true;
+    }
+
+    if (!cm_index_init(&cm->index, cm->cache_num)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cache_manager_node_t* node = cm_get_node(cm, i);
+
+        if (node->id != CACHE_MANAGER_INVALIDATE_ID) {
+            cm_index_insert(&cm->index, node->id, i);
+        }
+    }
+#endif
+    return true;
+}
+
+static bool cm_resize_policy_state(cache_manager_t* cm)
+{
+    /*ARC ghosts and the W-TinyLFU sketch are sized by cache_num and only
+     *hold history, they restart when their size changes*/
+    if (cm->mode == CACHE_MANAGER_MODE_ARC) {
+        if (cm->arc_p > cm->cache_num) {
+            cm->arc_p = cm->cache_num;
+        }
+
+        return cm_ghost_init(cm);
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_WTINYLFU) {
+        if (cm_sketch_get_width(cm->cache_num) != cm->sketch_mask + 1) {
+            return cm_sketch_init(cm);
+        }
+
+        cm->sketch_sample_limit = cm->cache_num * CACHE_MANAGER_WTINYLFU_SAMPLE_FACTOR;
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_CLOCK) {
+        cm->cache_tail %= cm->cache_num;
+    }
+
+    return true;
+}
+
+static void cm_fifo_rebuild(cache_manager_t* cm, cache_manager_node_t* tmp_array, const uint32_t* slot_array, uint32_t cnt)
+{
+    /*The FIFO order is the slot order of the ring, lay the residents out
+     *from the next victim like cm_fifo_compact()*/
+    for (uint32_t i = 0; i < cnt; i++) {
+        cm_move_out(cm, slot_array[i], tmp_array, cm->cache_num, i);
+    }
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        cm_move_in(cm, tmp_array, cm->cache_num, i);
+    }
+
+    cm_rebuild_free_slot(cm);
+    cm->cache_tail = 0;
+    cm->cache_head = (cnt < cm->cache_num) ? cnt : cnt - 1;
+}
+
+static void cm_policy_rebuild(cache_manager_t* cm, cache_manager_node_t* tmp_array, const uint32_t* slot_array, uint32_t cnt)
+{
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        cm_fifo_rebuild(cm, tmp_array, slot_array, cnt);
+        return;
+    }
+
+    /*From the hottest, like a warm start, ranks stand for the LIFE of nodes*/
+    for (uint32_t i = cnt; i > 0; i--) {
+        cache_manager_node_t* node = cm_get_node(cm, slot_array[i - 1]);
+        cache_manager_node_t state = *node;
+
+        state.priv.life = (int32_t)i;
+        cm_policy_attach(cm, node);
+        cm_policy_restore(cm, node, &state);
+
+        if (cm_mode_use_heap(cm->mode) && node->priv.pin_cnt > 0) {
+            cm_heap_remove(cm, node);
+        }
+    }
+}
+
+static cache_manager_res_t cm_shrink(cache_manager_t* cm, uint32_t cache_num)
+{
+    /*Let the policy pick the entries to drop, then move the survivors down*/
+    while (cm_get_resident_num(cm) > cache_num) {
+        cm_evict_node(cm, NULL);
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        if (!cm_fifo_compact(cm, cm->cache_num)) {
+            return CACHE_MANAGER_RES_ERR_UNKNOW;
+        }
+    } else {
+        uint32_t to = 0;
+
+        for (uint32_t from = cache_num; from < cm->cache_num; from++) {
+            if (cm_get_node(cm, from)->id == CACHE_MANAGER_INVALIDATE_ID) {
+                continue;
+            }
+
+            while (cm_get_node(cm, to)->id != CACHE_MANAGER_INVALIDATE_ID) {
+                to++;
+            }
+
+            cm_move_node(cm, from, to);
+        }
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_LFU && !cm_lfu_resize(cm, cache_num)) {
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    cm_resize_policy_arrays(cm, cache_num);
+    cm->cache_num = cache_num;
+    return CACHE_MANAGER_RES_OK;
+}
+
+static cache_manager_res_t cm_grow(cache_manager_t* cm, uint32_t cache_num)
+{
+    uint32_t old_num = cm->cache_num;
+
+    if (!cm_resize_policy_arrays(cm, cache_num)) {
+        CM_LOG_ERROR("resize to %" PRIu32 " failed", cache_num);
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_LFU && !cm_lfu_resize(cm, cache_num)) {
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    memset(&cm->cache_node_array[old_num], 0, sizeof(cache_manager_node_t) * (cache_num - old_num));
+
+#if !CACHE_MANAGER_USE_HASH
+    memset(&cm->id_array[old_num], 0, sizeof(int) * (cache_num - old_num));
+#endif
+
+    if (cm->key_array) {
+        memset(&cm->key_array[old_num + 1], 0, sizeof(cache_manager_key_t) * (cache_num - old_num));
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_CLOCK) {
+        for (uint32_t i = old_num; i < cache_num; i++) {
+            cm_clock_set_ref(cm, i, false);
+        }
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO && !cm_fifo_compact(cm, old_num)) {
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    cm->cache_num = cache_num;
+    return CACHE_MANAGER_RES_OK;
+}
+
+static void cm_free_buffers(cache_manager_t* cm)
+{
+    cm_mrc_disable(cm);
+    cm_adapt_disable(cm);
+    cm_l2_disable(cm);
+    if (cm->timer_wheel) {
+        CACHE_MANAGER_FREE(cm->timer_wheel);
+        cm->timer_wheel = NULL;
+    }
+    if (cm->timer_array) {
+        CACHE_MANAGER_FREE(cm->timer_array);
+        cm->timer_array = NULL;
+    }
+    if (cm->attach_tick_array) {
+        CACHE_MANAGER_FREE(cm->attach_tick_array);
+        cm->attach_tick_array = NULL;
+    }
+    if (cm->cache_node_array) {
+        CACHE_MANAGER_FREE(cm->cache_node_array);
+        cm->cache_node_array = NULL;
+    }
+    if (cm->free_slot_array) {
+        CACHE_MANAGER_FREE(cm->free_slot_array);
+        cm->free_slot_array = NULL;
+    }
+    cm_index_deinit(&cm->index);
+    cm_key_table_deinit(cm);
+    if (cm->key_array) {
+        CACHE_MANAGER_FREE(cm->key_array);
+        cm->key_array = NULL;
+    }
+    if (cm->id_array) {
+        CACHE_MANAGER_FREE(cm->id_array);
+        cm->id_array = NULL;
+    }
+    if (cm->heap_array) {
+        CACHE_MANAGER_FREE(cm->heap_array);
+        cm->heap_array = NULL;
+    }
+    if (cm->lfu_bucket_array) {
+        CACHE_MANAGER_FREE(cm->lfu_bucket_array);
+        cm->lfu_bucket_array = NULL;
+    }
+    if (cm->gdsf_priority_array) {
+        CACHE_MANAGER_FREE(cm->gdsf_priority_array);
+        cm->gdsf_priority_array = NULL;
+    }
+    if (cm->ghost_array) {
+        CACHE_MANAGER_FREE(cm->ghost_array);
+        cm->ghost_array = NULL;
+    }
+    cm_index_deinit(&cm->ghost_index);
+    if (cm->sketch_array) {
+        CACHE_MANAGER_FREE(cm->sketch_array);
+        cm->sketch_array = NULL;
+    }
+    if (cm->clock_ref_bitmap) {
+        CACHE_MANAGER_FREE(cm->clock_ref_bitmap);
+        cm->clock_ref_bitmap = NULL;
+    }
+    CACHE_MANAGER_FREE(cm);
+}
+
+cache_manager_t* cm_create(
+    uint32_t cache_num,
+    cache_manager_mode_t mode,
+    cache_manager_user_cb_t create_cb,
+    cache_manager_user_cb_t delete_cb,
+    cache_manager_tick_get_cb_t tick_get_cb,
+    void* user_data)
+{
+    cache_manager_t* cm = CACHE_MANAGER_MALLOC(sizeof(cache_manager_t));
+
+    if (!cm) {
+        CM_LOG_ERROR("cache_manager malloc failed");
+        return NULL;
+    }
+
+    memset(cm, 0, sizeof(cache_manager_t));
+
+    cm->cache_node_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_node_t) * cache_num);
+
+    if (!cm->cache_node_array) {
+        CM_LOG_ERROR("cache_node_array malloc failed");
+        CACHE_MANAGER_FREE(cm);
+        return NULL;
+    }
+
+    memset(cm->cache_node_array, 0, sizeof(cache_manager_node_t) * cache_num);
+
+    cm->cache_num = cache_num;
+
+    cm->free_slot_array = CACHE_MANAGER_MALLOC(sizeof(uint32_t) * cache_num);
+
+    if (!cm->free_slot_array) {
+        CM_LOG_ERROR("free_slot_array malloc failed");
+        goto failed;
+    }
+
+    cm_reset_free_slot(cm);
+
+#if CACHE_MANAGER_USE_HASH
+    if (!cm_index_init(&cm->index, cm->cache_num)) {
+        goto failed;
+    }
+#else
+    if (!cm_id_array_init(cm)) {
+        goto failed;
+    }
+#endif
+
+    if (tick_get_cb) {
+        cm->attach_tick_array = CACHE_MANAGER_MALLOC(sizeof(uint32_t) * cache_num);
+
+        if (!cm->attach_tick_array) {
+            CM_LOG_ERROR("attach_tick_array malloc failed");
+            goto failed;
+        }
+    }
+
+    cm->mode = mode;
+
+    if (!cm_policy_init(cm)) {
+        goto failed;
+    }
+
+    cm->create_cb = create_cb;
+    cm->delete_cb = delete_cb;
+    cm->tick_get_cb = tick_get_cb;
+    cm->user_data = user_data;
+
+    CM_LOG_INFO("cache_manager create OK, cache mode = %d, cache num = %d", mode, cache_num);
+
+    return cm;
+
+failed:
+    cm_free_buffers(cm);
+    return NULL;
+}
+
+cache_manager_res_t cm_set_cache_num(cache_manager_t* cm, uint32_t cache_num)
+{
+    if (cache_num == 0) {
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    if (cache_num == cm->cache_num) {
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    if (cm->lock_free_hit) {
+        /*Lock-free readers may still be probing the arrays a resize moves*/
+        CM_LOG_WARN("can't resize while lock-free hits are enabled");
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (cm->pin_node_cnt > 0) {
+        /*Resizing may move the node array, pointers held by the user would dangle*/
+        CM_LOG_WARN("%" PRIu32 " nodes are pinned, can't resize", cm->pin_node_cnt);
+        return CACHE_MANAGER_RES_ERR_PINNED;
+    }
+
+    uint32_t old_num = cm->cache_num;
+    cache_manager_res_t res = (cache_num < old_num) ? cm_shrink(cm, cache_num) : cm_grow(cm, cache_num);
+
+    if (res != CACHE_MANAGER_RES_OK) {
+        return res;
+    }
+
+    cm_rebuild_free_slot(cm);
+
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        /*Same ring state as after inserting the residents into an empty ring*/
+        cm->cache_head = (cm->cache_head < cache_num) ? cm->cache_head : cache_num - 1;
+    }
+
+    if (!cm_resize_index(cm) || !cm_resize_policy_state(cm)) {
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    CM_LOG_INFO("resized from %" PRIu32 " to %" PRIu32 ", %" PRIu32 " nodes kept", old_num, cache_num, cm_get_resident_num(cm));
+    return CACHE_MANAGER_RES_OK;
+}
+
+cache_manager_res_t cm_set_mode(cache_manager_t* cm, cache_manager_mode_t mode)
+{
+    cache_manager_res_t res = CACHE_MANAGER_RES_OK;
+    cache_manager_node_t* tmp_array = NULL;
+
+    if (mode >= _CACHE_MANAGER_MODE_LAST) {
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (mode == cm->mode) {
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    if (cm->lock_free_hit) {
+        /*Lock-free readers may still be probing the arrays a resize moves*/
+        CM_LOG_WARN("can't resize while lock-free hits are enabled");
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (mode == CACHE_MANAGER_MODE_FIFO) {
+        /*The ring is rebuilt by moving nodes, and it has no room for TTLs*/
+        if (cm->pin_node_cnt > 0) {
+            return CACHE_MANAGER_RES_ERR_PINNED;
+        }
+
+        if (cm->timer_cnt > 0 || cm->default_ttl > 0) {
+            CM_LOG_WARN("FIFO mode not support TTL");
+            return CACHE_MANAGER_RES_ERR_MODE;
+        }
+    }
+
+    uint32_t* slot_array = CACHE_MANAGER_MALLOC(sizeof(uint32_t) * cm->cache_num);
+
+    if (mode == CACHE_MANAGER_MODE_FIFO) {
+        tmp_array = cm_alloc_move_array(cm, cm->cache_num);
+    }
+
+    if (!slot_array || (mode == CACHE_MANAGER_MODE_FIFO && !tmp_array)) {
+        CM_LOG_ERROR("mode switch malloc failed");
+        res = CACHE_MANAGER_RES_ERR_UNKNOW;
+        goto failed;
+    }
+
+    /*Allocate everything before the switch, a failure leaves the old mode untouched*/
+    if (!cm_policy_alloc(cm, mode)) {
+        res = CACHE_MANAGER_RES_ERR_UNKNOW;
+        goto failed;
+    }
+
+    /*Residents stay, the new policy starts from the order of the old one*/
+    uint32_t cnt = cm_get_evict_order(cm, slot_array);
+
+    CM_LOG_INFO("cache mode %d -> %d, %" PRIu32 " nodes kept", cm->mode, mode, cnt);
+    cm->mode = mode;
+    cm_policy_reset(cm);
+
+    if (cm->tombstone_cnt > 0) {
+        /*Tombstones only make sense in the FIFO ring*/
+        cm_rebuild_free_slot(cm);
+    }
+
+    cm_policy_rebuild(cm, tmp_array, slot_array, cnt);
+    cm->stats.mode_switch_cnt++;
+
+    if (cm->mrc) {
+        cm_mrc_set_mode(cm);
+    }
+
+failed:
+    if (tmp_array) {
+        CACHE_MANAGER_FREE(tmp_array);
+    }
+    if (slot_array) {
+        CACHE_MANAGER_FREE(slot_array);
+    }
+    return res;
+}
+
+void cm_delete(cache_manager_t* cm)
+{
+    cm_clear(cm);
+    cm_free_buffers(cm);
+}
+
+static cache_manager_res_t cm_insert_node(cache_manager_t* cm, cache_manager_node_t* node_tmp, cache_manager_node_t** node_p);
+
+static cache_manager_res_t cm_open_miss(cache_manager_t* cm, int id, cache_manager_node_t** node_p)
+{
+    cache_manager_node_t node_tmp;
+    bool l2_loaded = false;
+    bool success = false;
+
+    if (cm->recycle && cm->free_slot_cnt == 0) {
+        /*Evict before creating, so that the victim's buffer can be reused*/
+        cache_manager_node_t recycled = { 0 };
+        cache_manager_res_t res = cm_evict_node(cm, &recycled);
+
+        if (res != CACHE_MANAGER_RES_OK) {
+            cm_key_drop_staged(cm);
+            return res;
+        }
+
+        success = cm_open_node(cm, &node_tmp, id, &recycled, &l2_loaded);
+    } else {
+        success = cm_open_node(cm, &node_tmp, id, NULL, &l2_loaded);
+    }
+
+    if (!success) {
+        cm_key_drop_staged(cm);
+        cm_record_open_fail(cm, id);
+        return CACHE_MANAGER_RES_ERR_CREATE_FAILED;
+    }
+
+    cm_record_open(cm, &node_tmp, l2_loaded);
+    return cm_insert_node(cm, &node_tmp, node_p);
+}
+
+cache_manager_res_t cm_open(cache_manager_t* cm, int id, cache_manager_node_t** node_p)
+{
+    cache_manager_res_t res = cm_lookup(cm, id, node_p);
+
+    if (res != CACHE_MANAGER_RES_ERR_ID_NOT_FOUND) {
+        return res;
+    }
+
+    return cm_open_miss(cm, id, node_p);
+}
+
+cache_manager_res_t cm_open_many(cache_manager_t* cm, const int* id_array, uint32_t num, cache_manager_node_t** node_array, cache_manager_res_t* res_array)
+{
+    uint32_t miss_cnt = 0;
+    cache_manager_res_t res = CACHE_MANAGER_RES_OK;
+
+    if (cm->key_table) {
+        for (uint32_t i = 0; i < num; i++) {
+            node_array[i] = NULL;
+            res_array[i] = CACHE_MANAGER_RES_ERR_MODE;
+        }
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_LIFE) {
+        /*The whole batch is one step of age*/
+        cm_life_age(cm);
+    }
+
+    /*Resolve hits in one pass, pinning them so that the misses below can't evict them*/
+    for (uint32_t i = 0; i < num; i++) {
+        node_array[i] = NULL;
+
+#if CACHE_MANAGER_USE_HASH
+        /*Start fetching the buckets of the next ids while this one is probed*/
+        if (i + CACHE_MANAGER_PREFETCH_DISTANCE < num) {
+            cm_index_prefetch(&cm->index, id_array[i + CACHE_MANAGER_PREFETCH_DISTANCE]);
+        }
+#endif
+
+        if (id_array[i] == CACHE_MANAGER_INVALIDATE_ID) {
+            res_array[i] = CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+            continue;
+        }
+
+        cm->stats.open_cnt++;
+
+        if (cm->mrc) {
+            cm_mrc_access(cm, id_array[i]);
+        }
+
+        if (cm->adapt) {
+            cm_adapt_access(cm, id_array[i]);
+        }
+
+        cache_manager_node_t* node = cm_find_live_node(cm, id_array[i]);
+
+        if (!node) {
+            res_array[i] = CACHE_MANAGER_RES_ERR_ID_NOT_FOUND;
+            cm->stats.miss_cnt++;
+            cm_trace_event(cm, CACHE_MANAGER_TRACE_MISS, id_array[i], 0);
+            miss_cnt++;
+            continue;
+        }
+
+        cm_inc_node_ref_cnt(node);
+        cm->stats.hit_cnt++;
+        cm_trace_event(cm, CACHE_MANAGER_TRACE_HIT, node->id, 0);
+        cm_policy_touch(cm, node);
+        cm_pin_node(cm, node);
+
+        node_array[i] = node;
+        res_array[i] = CACHE_MANAGER_RES_OK;
+    }
+
+    CM_LOG_INFO("open %" PRIu32 " ids, %" PRIu32 " misses", num, miss_cnt);
+
+    cache_manager_node_t* miss_array = NULL;
+    cache_manager_node_t** resident_array = NULL;
+    cache_manager_res_t* miss_res_array = NULL;
+    bool* success_array = NULL;
+    cache_manager_index_t miss_index = { 0 };
+    uint32_t unique_cnt = 0;
+
+    if (miss_cnt > 0) {
+        miss_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_node_t) * miss_cnt);
+        resident_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_node_t*) * miss_cnt);
+        miss_res_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_res_t) * miss_cnt);
+        success_array = CACHE_MANAGER_MALLOC(sizeof(bool) * miss_cnt);
+
+        if (!miss_array || !resident_array || !miss_res_array || !success_array || !cm_index_init(&miss_index, miss_cnt)) {
+            CM_LOG_ERROR("miss array malloc failed");
+            res = CACHE_MANAGER_RES_ERR_UNKNOW;
+            goto failed;
+        }
+    }
+
+    /*Gather the distinct missing ids, so that each one is created once*/
+    for (uint32_t i = 0; i < num && unique_cnt < miss_cnt; i++) {
+        if (res_array[i] != CACHE_MANAGER_RES_ERR_ID_NOT_FOUND
+            || cm_index_find(&miss_index, id_array[i]) != CACHE_MANAGER_NODE_NONE) {
+            continue;
+        }
+
+        memset(&miss_array[unique_cnt], 0, sizeof(cache_manager_node_t));
+        miss_array[unique_cnt].cache_manager = cm;
+        miss_array[unique_cnt].id = id_array[i];
+        cm_index_insert(&miss_index, id_array[i], unique_cnt);
+        unique_cnt++;
+    }
+
+    if (unique_cnt > 0) {
+        cm_open_many_create(cm, miss_array, success_array, unique_cnt);
+    }
+
+    for (uint32_t i = 0; i < unique_cnt; i++) {
+        resident_array[i] = NULL;
+
+        if (!success_array[i]) {
+            miss_res_array[i] = CACHE_MANAGER_RES_ERR_CREATE_FAILED;
+            continue;
+        }
+
+        miss_res_array[i] = cm_insert_node(cm, &miss_array[i], &resident_array[i]);
+
+        if (miss_res_array[i] == CACHE_MANAGER_RES_OK) {
+            cm_pin_node(cm, resident_array[i]);
+        }
+    }
+
+    for (uint32_t i = 0; i < unique_cnt; i++) {
+        if (miss_res_array[i] == CACHE_MANAGER_RES_OK) {
+            cm_unpin_node(cm, resident_array[i]);
+        }
+    }
+
+failed:
+    for (uint32_t i = 0; i < num; i++) {
+        if (res_array[i] == CACHE_MANAGER_RES_OK) {
+            cm_unpin_node(cm, node_array[i]);
+        } else if (res_array[i] == CACHE_MANAGER_RES_ERR_ID_NOT_FOUND) {
+            /*Copy the outcome of the distinct miss to every occurrence of its id*/
+            if (res == CACHE_MANAGER_RES_ERR_UNKNOW) {
+                res_array[i] = res;
+            } else {
+                uint32_t miss = cm_index_find(&miss_index, id_array[i]);
+                res_array[i] = miss_res_array[miss];
+                node_array[i] = resident_array[miss];
+            }
+        }
+
+        if (res_array[i] != CACHE_MANAGER_RES_OK && res == CACHE_MANAGER_RES_OK) {
+            res = res_array[i];
+        }
+    }
+
+    cm_index_deinit(&miss_index);
+    if (miss_array) {
+        CACHE_MANAGER_FREE(miss_array);
+    }
+    if (resident_array) {
+        CACHE_MANAGER_FREE(resident_array);
+    }
+    if (miss_res_array) {
+        CACHE_MANAGER_FREE(miss_res_array);
+    }
+    if (success_array) {
+        CACHE_MANAGER_FREE(success_array);
+    }
+
+    return res;
+}
+
+cache_manager_res_t cm_acquire(cache_manager_t* cm, int id, cache_manager_node_t** node_p)
+{
+    cache_manager_res_t res = cm_open(cm, id, node_p);
+
+    if (res == CACHE_MANAGER_RES_OK) {
+        cm_pin_node(cm, *node_p);
+    }
+
+    return res;
+}
+
+void cm_pin(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    cm_pin_node(cm, node);
+}
+
+void cm_release(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    if (node->priv.pin_cnt == 0) {
+        CM_LOG_WARN("id:%d released but not pinned", node->id);
+        return;
+    }
+
+    cm_unpin_node(cm, node);
+}
+
+static void cm_lookup_begin(cache_manager_t* cm, int id)
+{
+    cm->stats.open_cnt++;
+
+    if (cm->mrc) {
+        cm_mrc_access(cm, id);
+    }
+
+    if (cm->adapt) {
+        cm_adapt_access(cm, id);
+    }
+
+    if (cm->mode == CACHE_MANAGER_MODE_LIFE) {
+        cm_life_age(cm);
+    }
+}
+
+static cache_manager_res_t cm_lookup_end(cache_manager_t* cm, int id, cache_manager_node_t* node, cache_manager_node_t** node_p)
+{
+    if (!node) {
+        CM_LOG_INFO("id:%d cache miss", id);
+        cm->stats.miss_cnt++;
+        cm_trace_event(cm, CACHE_MANAGER_TRACE_MISS, id, 0);
+        return CACHE_MANAGER_RES_ERR_ID_NOT_FOUND;
+    }
+
+    cm_inc_node_ref_cnt(node);
+    *node_p = node;
+    cm->stats.hit_cnt++;
+    cm_trace_event(cm, CACHE_MANAGER_TRACE_HIT, node->id, 0);
+    CM_LOG_INFO("id:%d cache hit context %p, ref_cnt = %" PRIu32, node->id, node->context.ptr, node->priv.ref_cnt);
+
+    cm_policy_touch(cm, node);
+
+    return CACHE_MANAGER_RES_OK;
+}
+
+cache_manager_res_t cm_lookup(cache_manager_t* cm, int id, cache_manager_node_t** node_p)
+{
+    if (id == CACHE_MANAGER_INVALIDATE_ID) {
+        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    }
+
+    if (cm->key_table) {
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    cm_lookup_begin(cm, id);
+    return cm_lookup_end(cm, id, cm_find_live_node(cm, id), node_p);
+}
+
+cache_manager_node_t* cm_peek(cache_manager_t* cm, int id)
+{
+    if (id == CACHE_MANAGER_INVALIDATE_ID || cm->key_table) {
+        return NULL;
+    }
+
+    cache_manager_node_t* node = cm_find_node(cm, id);
+
+    if (node && cm_node_is_expired(cm, node)) {
+        return NULL;
+    }
+
+    return node;
+}
+
+/*Only safe because lock_free_hit keeps the arrays read here from being reallocated*/
+cache_manager_node_t* cm_find_optimistic(cache_manager_t* cm, int id)
+{
+    uint32_t slot = CACHE_MANAGER_NODE_NONE;
+
+    if (id == CACHE_MANAGER_INVALIDATE_ID) {
+        return NULL;
+    }
+
+#if CACHE_MANAGER_USE_HASH
+    /*A writer may be shifting entries meanwhile, bound the probe to the table*/
+    const cache_manager_index_entry_t* table = cm->index.table;
+    uint32_t mask = cm->index.mask;
+    uint32_t pos = cm_hash_id(id) & mask;
+
+    for (uint32_t i = 0; i <= mask; i++) {
+        int entry_id = CM_ATOMIC_LOAD(&table[pos].id);
+
+        if (entry_id == CACHE_MANAGER_INVALIDATE_ID) {
+            break;
+        }
+
+        if (entry_id == id) {
+            slot = CM_ATOMIC_LOAD(&table[pos].slot);
+            break;
+        }
+
+        pos = (pos + 1) & mask;
+    }
+#else
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        if (CM_ATOMIC_LOAD(&cm->id_array[i]) == id) {
+            slot = i;
+            break;
+        }
+    }
+#endif
+
+    if (slot >= cm->cache_num) {
+        return NULL;
+    }
+
+    cache_manager_node_t* node = cm_get_node(cm, slot);
+
+    /*Entries with a deadline are left to the locked path, which expires them*/
+    if (CM_ATOMIC_LOAD(&node->id) != id
+        || CM_ATOMIC_LOAD(&node->priv.timed)) {
+        return NULL;
+    }
+
+    return node;
+}
+
+void cm_replay_hit(cache_manager_t* cm, int id, uint32_t slot)
+{
+    cm_lookup_begin(cm, id);
+    cm->stats.hit_cnt++;
+    cm_trace_event(cm, CACHE_MANAGER_TRACE_HIT, id, 0);
+
+    if (slot >= cm->cache_num) {
+        return;
+    }
+
+    cache_manager_node_t* node = cm_get_node(cm, slot);
+
+    /*The slot may have been reused since the hit, then only the count remains*/
+    if (node->id != id) {
+        return;
+    }
+
+    cm_inc_node_ref_cnt(node);
+    cm_policy_touch(cm, node);
+}
+
+cache_manager_res_t cm_load(cache_manager_t* cm, int id, cache_manager_node_t* node)
+{
+    if (id == CACHE_MANAGER_INVALIDATE_ID) {
+        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    }
+
+    if (cm->key_table) {
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    return cm_open_node(cm, node, id, NULL, NULL) ? CACHE_MANAGER_RES_OK : CACHE_MANAGER_RES_ERR_CREATE_FAILED;
+}
+
+void cm_load_failed(cache_manager_t* cm, int id)
+{
+    cm_record_open_fail(cm, id);
+}
+
+cache_manager_res_t cm_insert(cache_manager_t* cm, cache_manager_node_t* node_tmp, cache_manager_node_t** node_p)
+{
+    if (cm->key_table) {
+        cm_drop_node(cm, node_tmp);
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    cm_record_open(cm, node_tmp, false);
+    return cm_insert_node(cm, node_tmp, node_p);
+}
+
+static cache_manager_res_t cm_insert_node(cache_manager_t* cm, cache_manager_node_t* node_tmp, cache_manager_node_t** node_p)
+{
+    cache_manager_node_t* node = cm_find_node(cm, node_tmp->id);
+
+    if (node) {
+        /*Another loader installed the same id in the meantime, keep the resident one*/
+        CM_LOG_INFO("id:%d already resident, drop the new context", node_tmp->id);
+        cm_drop_node(cm, node_tmp);
+        *node_p = node;
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    if (cm->byte_limit > 0 && node_tmp->context.size > cm->byte_limit) {
+        CM_LOG_WARN("id:%d size %" PRIu32 " exceeds the byte limit", node_tmp->id, node_tmp->context.size);
+        cm_drop_node(cm, node_tmp);
+        return CACHE_MANAGER_RES_ERR_TOO_LARGE;
+    }
+
+    cm_policy_admit(cm, node_tmp->id);
+
+    if (cm->timer_cnt > 0 && cm->free_slot_cnt == 0) {
+        /*Expired entries make room before live ones get evicted*/
+        cm_timer_advance(cm);
+    }
+
+    /*Make room for one more node, and for its bytes when there is a budget*/
+    while (cm->free_slot_cnt == 0 || cm_over_byte_limit(cm, node_tmp->context.size)) {
+        CM_LOG_INFO("cache full, find reuse node...");
+
+        cache_manager_res_t res = cm_evict_node(cm, NULL);
+
+        if (res != CACHE_MANAGER_RES_OK) {
+            cm_drop_node(cm, node_tmp);
+            return res;
+        }
+    }
+
+    node = cm_find_empty_node(cm);
+
+    *node = *node_tmp;
+
+    if (cm->key_array) {
+        /*The staged key goes with the node to its slot*/
+        cm->key_array[cm_node_get_slot(cm, node)] = *cm_key_get_staged(cm);
+        cm_key_get_staged(cm)->len = 0;
+    }
+
+    cm_inc_node_ref_cnt(node);
+    cm_attach_node(cm, node);
+    *node_p = node;
+
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        cm_node_fifo_push(cm);
+    }
+
+    return CACHE_MANAGER_RES_OK;
+}
+
+uint32_t cm_get_evict_order(cache_manager_t* cm, uint32_t* slot_array)
+{
+    uint32_t cnt = 0;
+
+    switch (cm->mode) {
+    case CACHE_MANAGER_MODE_LRU:
+        cnt = cm_order_add_list(cm, &cm->lru_list, slot_array, cnt);
+        break;
+
+    case CACHE_MANAGER_MODE_LIFE:
+    case CACHE_MANAGER_MODE_GDSF:
+        cnt = cm_order_add_heap(cm, slot_array);
+        break;
+
+    case CACHE_MANAGER_MODE_LFU:
+        for (uint32_t index = cm->lfu_bucket_head; index != CACHE_MANAGER_NODE_NONE; index = cm_lfu_get_bucket(cm, index)->next) {
+            cnt = cm_order_add_list(cm, &cm_lfu_get_bucket(cm, index)->list, slot_array, cnt);
+        }
+        break;
+
+    case CACHE_MANAGER_MODE_ARC:
+        cnt = cm_order_add_list(cm, &cm->seg_list[CACHE_MANAGER_ARC_T1], slot_array, cnt);
+        cnt = cm_order_add_list(cm, &cm->seg_list[CACHE_MANAGER_ARC_T2], slot_array, cnt);
+        break;
+
+    case CACHE_MANAGER_MODE_WTINYLFU:
+        cnt = cm_order_add_list(cm, &cm->seg_list[CACHE_MANAGER_WTINYLFU_PROBATION], slot_array, cnt);
+        cnt = cm_order_add_list(cm, &cm->seg_list[CACHE_MANAGER_WTINYLFU_WINDOW], slot_array, cnt);
+        cnt = cm_order_add_list(cm, &cm->seg_list[CACHE_MANAGER_WTINYLFU_PROTECTED], slot_array, cnt);
+        break;
+
+    case CACHE_MANAGER_MODE_FIFO:
+    case CACHE_MANAGER_MODE_CLOCK:
+        cnt = cm_order_add_ring(cm, slot_array, cm->mode == CACHE_MANAGER_MODE_CLOCK);
+        break;
+
+    default:
+        /*RANDOM has no order, go by slot*/
+        for (uint32_t i = 0; i < cm->cache_num; i++) {
+            if (cm_get_node(cm, i)->id != CACHE_MANAGER_INVALIDATE_ID) {
+                slot_array[cnt++] = i;
+            }
+        }
+        break;
+    }
+
+    return cnt;
+}
+
+cache_manager_res_t cm_restore(cache_manager_t* cm, const cache_manager_node_t* state)
+{
+    if (state->id == CACHE_MANAGER_INVALIDATE_ID) {
+        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    }
+
+    if (cm->key_table) {
+        /*The ids of keyed nodes mean nothing without their keys*/
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (cm_find_node(cm, state->id)) {
+        /*Live traffic got there first, its state is newer*/
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    if (cm->free_slot_cnt == 0) {
+        return CACHE_MANAGER_RES_ERR_FULL;
+    }
+
+    cache_manager_node_t node_tmp;
+
+    bool l2_loaded = false;
+
+    if (!cm_open_node(cm, &node_tmp, state->id, NULL, &l2_loaded)) {
+        cm_record_open_fail(cm, state->id);
+        return CACHE_MANAGER_RES_ERR_CREATE_FAILED;
+    }
+
+    cm_record_open(cm, &node_tmp, l2_loaded);
+
+    if (cm_over_byte_limit(cm, node_tmp.context.size)) {
+        cm_drop_node(cm, &node_tmp);
+        return CACHE_MANAGER_RES_ERR_FULL;
+    }
+
+    cache_manager_node_t* node = cm_find_empty_node(cm);
+
+    *node = node_tmp;
+    node->priv.ref_cnt = state->priv.ref_cnt > 0 ? state->priv.ref_cnt : 1;
+
+    if (state->priv.time_to_open > 0) {
+        node->priv.time_to_open = state->priv.time_to_open;
+    }
+
+    cm_attach_node(cm, node);
+    cm_policy_restore(cm, node, state);
+
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        cm_node_fifo_push(cm);
+    }
+
+    return CACHE_MANAGER_RES_OK;
+}
+
+cache_manager_res_t cm_set_default_ttl(cache_manager_t* cm, uint32_t ttl)
+{
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        CM_LOG_WARN("FIFO mode not support TTL");
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (ttl > 0 && !cm_timer_init(cm)) {
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    cm->default_ttl = ttl;
+    return CACHE_MANAGER_RES_OK;
+}
+
+cache_manager_res_t cm_set_ttl(cache_manager_t* cm, cache_manager_node_t* node, uint32_t ttl)
+{
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        CM_LOG_WARN("FIFO mode not support TTL");
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (node->id == CACHE_MANAGER_INVALIDATE_ID) {
+        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    }
+
+    if (ttl == 0) {
+        cm_timer_remove(cm, node);
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    if (!cm_timer_init(cm)) {
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    cm_timer_start(cm, node, ttl);
+    return CACHE_MANAGER_RES_OK;
+}
+
+uint32_t cm_expire_tick(cache_manager_t* cm)
+{
+    return cm->timer_wheel ? cm_timer_advance(cm) : 0;
+}
+
+void cm_set_recycle(cache_manager_t* cm, bool recycle)
+{
+    cm->recycle = recycle;
+}
+
+void cm_set_batch_create_cb(cache_manager_t* cm, cache_manager_batch_cb_t batch_create_cb)
+{
+    cm->batch_create_cb = batch_create_cb;
+}
+
+void cm_set_byte_limit(cache_manager_t* cm, uint64_t byte_limit)
+{
+    cm->byte_limit = byte_limit;
+
+    while (cm_over_byte_limit(cm, 0) && cm_get_resident_num(cm) > 0) {
+        if (cm_evict_node(cm, NULL) != CACHE_MANAGER_RES_OK) {
+            break;
+        }
+    }
+}
+
+static cache_manager_res_t cm_invalidate_node(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    if (node->priv.pin_cnt > 0) {
+        CM_LOG_WARN("id:%d is pinned, can't invalidate", node->id);
+        return CACHE_MANAGER_RES_ERR_PINNED;
+    }
+
+    cm_trace_event(cm, CACHE_MANAGER_TRACE_INVALIDATE, node->id, 0);
+    cm_close_node(node);
+
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO) {
+        /*A new node in this slot would take an old place in the ring*/
+        node->priv.pos = CACHE_MANAGER_FIFO_TOMBSTONE;
+        cm->tombstone_cnt++;
+    } else {
+        cm_push_free_slot(cm, node);
+    }
+
+    cm->stats.invalidate_cnt++;
+    return CACHE_MANAGER_RES_OK;
+}
+
+cache_manager_res_t cm_invalidate(cache_manager_t* cm, int id)
+{
+    if (id == CACHE_MANAGER_INVALIDATE_ID) {
+        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    }
+
+    if (cm->key_table) {
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    cache_manager_node_t* node = cm_find_node(cm, id);
+
+    if (!node) {
+        return cm->l2 && cm_l2_remove(cm, id) ? CACHE_MANAGER_RES_OK : CACHE_MANAGER_RES_ERR_ID_NOT_FOUND;
+    }
+
+    cache_manager_res_t res = cm_invalidate_node(cm, node);
+
+    /*A pinned node keeps its L2 copy as well*/
+    if (res == CACHE_MANAGER_RES_OK && cm->l2) {
+        cm_l2_remove(cm, id);
+    }
+
+    return res;
+}
+
+uint32_t cm_invalidate_many(cache_manager_t* cm, const int* id_array, uint32_t num)
+{
+    uint32_t cnt = 0;
+
+    if (cm->key_table) {
+        return 0;
+    }
+
+#if CACHE_MANAGER_USE_HASH
+    for (uint32_t i = 0; i < num; i++) {
+        if (id_array[i] == CACHE_MANAGER_INVALIDATE_ID) {
+            continue;
+        }
+
+        cache_manager_node_t* node = cm_find_node(cm, id_array[i]);
+
+        if (node) {
+            if (cm_invalidate_node(cm, node) != CACHE_MANAGER_RES_OK) {
+                continue;
+            }
+
+            cnt++;
+        }
+
+        if (cm->l2) {
+            cm_l2_remove(cm, id_array[i]);
+        }
+    }
+#else
+    /*Index the ids instead, then match them in a single scan of the slots*/
+    cache_manager_index_t id_set = { 0 };
+
+    if (!cm_index_init(&id_set, num)) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < num; i++) {
+        if (id_array[i] != CACHE_MANAGER_INVALIDATE_ID
+            && cm_index_find(&id_set, id_array[i]) == CACHE_MANAGER_NODE_NONE) {
+            cm_index_insert(&id_set, id_array[i], i);
+        }
+    }
+
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        int id = cm->id_array[i];
+
+        if (id == CACHE_MANAGER_INVALIDATE_ID || cm_index_find(&id_set, id) == CACHE_MANAGER_NODE_NONE) {
+            continue;
+        }
+
+        if (cm_invalidate_node(cm, cm_get_node(cm, i)) == CACHE_MANAGER_RES_OK) {
+            cnt++;
+        } else {
+            /*Pinned, its L2 copy stays with it*/
+            cm_index_remove(&id_set, id);
+        }
+    }
+
+    if (cm->l2) {
+        for (uint32_t i = 0; i < num; i++) {
+            if (id_array[i] != CACHE_MANAGER_INVALIDATE_ID
+                && cm_index_find(&id_set, id_array[i]) != CACHE_MANAGER_NODE_NONE) {
+                cm_l2_remove(cm, id_array[i]);
+            }
+        }
+    }
+
+    cm_index_deinit(&id_set);
+#endif
+
+    return cnt;
+}
+
+uint32_t cm_invalidate_if(cache_manager_t* cm, cache_manager_predicate_cb_t predicate, void* user_data)
+{
+    uint32_t cnt = 0;
+
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cache_manager_node_t* node = cm_get_node(cm, i);
+        int id = node->id;
+
+        if (id == CACHE_MANAGER_INVALIDATE_ID || !predicate(node, user_data)) {
+            continue;
+        }
+
+        if (cm_invalidate_node(cm, node) == CACHE_MANAGER_RES_OK) {
+            cnt++;
+
+            if (cm->l2) {
+                cm_l2_remove(cm, id);
+            }
+        }
+    }
+
+    return cnt;
+}
+
+cache_manager_res_t cm_set_key_mode(cache_manager_t* cm, bool key_mode)
+{
+    if (key_mode == (cm->key_table != NULL)) {
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    if (cm->lock_free_hit) {
+        /*Lock-free readers may still be probing the arrays a resize moves*/
+        CM_LOG_WARN("can't resize while lock-free hits are enabled");
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    /*Keyed and int id nodes can't share the id space*/
+    if (cm_get_resident_num(cm) > 0 || cm->l2) {
+        CM_LOG_WARN("key mode can only be switched on an empty cache without L2");
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (!key_mode) {
+        cm_key_table_deinit(cm);
+        CACHE_MANAGER_FREE(cm->key_array);
+        cm->key_array = NULL;
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    /*One entry per slot, and one for the key of the node being created*/
+    cm->key_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_key_t) * (cm->cache_num + 1));
+
+    if (!cm->key_array || !cm_key_table_init(cm)) {
+        CM_LOG_ERROR("key mode malloc failed");
+        if (cm->key_array) {
+            CACHE_MANAGER_FREE(cm->key_array);
+            cm->key_array = NULL;
+        }
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    memset(cm->key_array, 0, sizeof(cache_manager_key_t) * (cm->cache_num + 1));
+    return CACHE_MANAGER_RES_OK;
+}
+
+cache_manager_res_t cm_open_key(cache_manager_t* cm, const void* key, uint32_t len, cache_manager_node_t** node_p)
+{
+    if (!cm->key_table) {
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (!key || len == 0) {
+        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    }
+
+    uint32_t hash = cm_key_hash(key, len);
+    int id = cm_key_get_id(hash);
+
+    cm_lookup_begin(cm, id);
+    cache_manager_res_t res = cm_lookup_end(cm, id, cm_find_live_key_node(cm, key, len, hash), node_p);
+
+    if (res != CACHE_MANAGER_RES_ERR_ID_NOT_FOUND) {
+        return res;
+    }
+
+    /*Another key may hold the id of this hash, take the next free one*/
+    while (cm_find_node(cm, id)) {
+        id = (id < INT32_MAX) ? id + 1 : 1;
+    }
+
+    if (!cm_key_init(cm_key_get_staged(cm), key, len, hash)) {
+        return CACHE_MANAGER_RES_ERR_CREATE_FAILED;
+    }
+
+    return cm_open_miss(cm, id, node_p);
+}
+
+cache_manager_res_t cm_acquire_key(cache_manager_t* cm, const void* key, uint32_t len, cache_manager_node_t** node_p)
+{
+    cache_manager_res_t res = cm_open_key(cm, key, len, node_p);
+
+    if (res == CACHE_MANAGER_RES_OK) {
+        cm_pin_node(cm, *node_p);
+    }
+
+    return res;
+}
+
+cache_manager_res_t cm_invalidate_key(cache_manager_t* cm, const void* key, uint32_t len)
+{
+    if (!cm->key_table) {
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    if (!key || len == 0) {
+        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    }
+
+    uint32_t slot = cm_key_table_find(cm, key, len, cm_key_hash(key, len));
+
+    if (slot == CACHE_MANAGER_NODE_NONE) {
+        return CACHE_MANAGER_RES_ERR_ID_NOT_FOUND;
+    }
+
+    return cm_invalidate_node(cm, cm_get_node(cm, slot));
+}
+
+cache_manager_node_t* cm_peek_key(cache_manager_t* cm, const void* key, uint32_t len)
+{
+    if (!cm->key_table || !key || len == 0) {
+        return NULL;
+    }
+
+    uint32_t slot = cm_key_table_find(cm, key, len, cm_key_hash(key, len));
+
+    if (slot == CACHE_MANAGER_NODE_NONE) {
+        return NULL;
+    }
+
+    cache_manager_node_t* node = cm_get_node(cm, slot);
+    return cm_node_is_expired(cm, node) ? NULL : node;
+}
+
+cache_manager_res_t cm_open_u64(cache_manager_t* cm, uint64_t key, cache_manager_node_t** node_p)
+{
+    return cm_open_key(cm, &key, sizeof(key), node_p);
+}
+
+cache_manager_res_t cm_invalidate_u64(cache_manager_t* cm, uint64_t key)
+{
+    return cm_invalidate_key(cm, &key, sizeof(key));
+}
+
+cache_manager_node_t* cm_peek_u64(cache_manager_t* cm, uint64_t key)
+{
+    return cm_peek_key(cm, &key, sizeof(key));
+}
+
+const void* cm_node_get_key(const cache_manager_node_t* node, uint32_t* len)
+{
+    cache_manager_t* cm = node->cache_manager;
+    *len = 0;
+
+    if (!cm || !cm->key_array) {
+        return NULL;
+    }
+
+    /*A node out of the array is the one being created, its key is staged*/
+    uintptr_t offset = (uintptr_t)node - (uintptr_t)cm->cache_node_array;
+    const cache_manager_key_t* key = offset < sizeof(cache_manager_node_t) * cm->cache_num
+        ? &cm->key_array[offset / sizeof(cache_manager_node_t)]
+        : cm_key_get_staged(cm);
+
+    *len = key->len;
+    return key->len > 0 ? cm_key_get_data(key) : NULL;
+}
+
+void cm_clear(cache_manager_t* cm)
+{
+    cm->cache_head = cm->cache_tail = 0;
+    for (uint32_t i = 0; i < cm->cache_num; i++) {
+        cache_manager_node_t* node = &(cm->cache_node_array[i]);
+        if (node->id != CACHE_MANAGER_INVALIDATE_ID) {
+            cm_close_node(node);
+        } else {
+            node->priv.pos = 0;
+        }
+    }
+
+    cm_reset_free_slot(cm);
+    cm->tombstone_cnt = 0;
+
+    /*Pinned nodes were closed as well, later releases of them are no-ops*/
+    cm->pin_node_cnt = 0;
+
+    if (cm->l2) {
+        cm_l2_clear(cm);
+    }
+}
+
+int cm_get_cache_hit_rate(cache_manager_t* cm)
+{
+    if (cm->stats.open_cnt == 0) {
+        return 0;
+    }
+
+    return (int)(cm->stats.hit_cnt * 1000 / cm->stats.open_cnt);
+}
+
+void cm_reset_cache_hit_cnt(cache_manager_t* cm)
+{
+    memset(&cm->stats, 0, sizeof(cache_manager_stats_t));
+}
+
+void cm_get_stats(cache_manager_t* cm, cache_manager_stats_t* stats)
+{
+    *stats = cm->stats;
+}
+
+void cm_stats_merge(cache_manager_stats_t* dst, const cache_manager_stats_t* src)
+{
+    dst->open_cnt += src->open_cnt;
+    dst->hit_cnt += src->hit_cnt;
+    dst->miss_cnt += src->miss_cnt;
+    dst->evict_cnt += src->evict_cnt;
+    dst->invalidate_cnt += src->invalidate_cnt;
+    dst->create_fail_cnt += src->create_fail_cnt;
+    dst->expire_cnt += src->expire_cnt;
+    dst->l2_hit_cnt += src->l2_hit_cnt;
+    dst->l2_spill_cnt += src->l2_spill_cnt;
+    dst->mode_switch_cnt += src->mode_switch_cnt;
+
+    for (uint32_t i = 0; i < CACHE_MANAGER_HIST_BUCKET_NUM; i++) {
+        dst->open_time_hist[i] += src->open_time_hist[i];
+        dst->lifetime_hist[i] += src->lifetime_hist[i];
+    }
 }
@@ -31,11 +31,30 @@
 extern "C" {
 #endif
 
+#define CACHE_MANAGER_INVALIDATE_ID 0
+
 struct cache_manager_s;
 struct cache_manager_node_s;
+struct cache_manager_mrc_s;
+struct cache_manager_adapt_s;
+struct cache_manager_trace_s;
+struct cache_manager_l2_s;
 
 typedef bool (*cache_manager_user_cb_t)(struct cache_manager_node_s* node);
 typedef uint32_t (*cache_manager_tick_get_cb_t)(void);
+typedef void (*cache_manager_batch_cb_t)(struct cache_manager_node_s* node_array, bool* success_array, uint32_t num);
+typedef bool (*cache_manager_predicate_cb_t)(const struct cache_manager_node_s* node, void* user_data);
+
+#define CACHE_MANAGER_KEY_INLINE_SIZE 16
+
+typedef struct cache_manager_key_s {
+    uint32_t len; /* 0 for an empty entry */
+    uint32_t hash;
+    union {
+        uint8_t data[CACHE_MANAGER_KEY_INLINE_SIZE]; /* len <= CACHE_MANAGER_KEY_INLINE_SIZE */
+        uint8_t* ptr; /* longer keys, owned by the entry */
+    } buf;
+} cache_manager_key_t;
 
 typedef struct cache_manager_node_s {
     struct cache_manager_s* cache_manager;
@@ -50,6 +69,11 @@ typedef struct cache_manager_node_s {
         int32_t life;
         uint32_t ref_cnt;
         uint32_t time_to_open;
+        uint32_t prev; /* policy list links (slot index) */
+        uint32_t next;
+        uint32_t pos; /* heap position, LFU frequency bucket, segment or FIFO tombstone */
+        uint32_t pin_cnt;
+        bool timed; /* has a deadline, its wheel links are in timer_array */
     } priv;
 } cache_manager_node_t;
 
@@ -59,30 +83,166 @@ typedef enum cache_manager_mode_e {
     CACHE_MANAGER_MODE_LFU, /* less frequently used */
     CACHE_MANAGER_MODE_LRU, /* least recently used */
     CACHE_MANAGER_MODE_RANDOM, /* random */
+    CACHE_MANAGER_MODE_GDSF, /* greedy dual size frequency */
+    CACHE_MANAGER_MODE_ARC, /* adaptive replacement cache */
+    CACHE_MANAGER_MODE_WTINYLFU, /* window tiny lfu */
+    CACHE_MANAGER_MODE_CLOCK, /* second chance, approximates lru */
     _CACHE_MANAGER_MODE_LAST
 } cache_manager_mode_t;
 
 typedef enum cache_manager_res_e {
     CACHE_MANAGER_RES_OK,
+    CACHE_MANAGER_RES_PENDING,
     CACHE_MANAGER_RES_ERR_ID_NOT_FOUND,
     CACHE_MANAGER_RES_ERR_ID_INVALIDATE,
     CACHE_MANAGER_RES_ERR_CREATE_FAILED,
     CACHE_MANAGER_RES_ERR_MODE,
+    CACHE_MANAGER_RES_ERR_PINNED,
+    CACHE_MANAGER_RES_ERR_TOO_LARGE,
+    CACHE_MANAGER_RES_ERR_FULL,
     CACHE_MANAGER_RES_ERR_UNKNOW
 } cache_manager_res_t;
 
+typedef struct cache_manager_index_entry_s {
+    int id;
+    uint32_t slot;
+} cache_manager_index_entry_t;
+
+typedef struct cache_manager_index_s {
+    cache_manager_index_entry_t* table;
+    uint32_t mask;
+} cache_manager_index_t;
+
+typedef struct cache_manager_key_entry_s {
+    uint32_t hash; /* fingerprint, compared before the key bytes */
+    uint32_t slot; /* NONE for an empty entry */
+} cache_manager_key_entry_t;
+
+#define CACHE_MANAGER_SEG_NUM 3
+
+typedef struct cache_manager_list_s {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t cnt;
+} cache_manager_list_t;
+
+typedef struct cache_manager_ghost_s {
+    int id;
+    uint32_t list;
+    uint32_t prev;
+    uint32_t next;
+} cache_manager_ghost_t;
+
+typedef struct cache_manager_lfu_bucket_s {
+    uint32_t freq;
+    cache_manager_list_t list;
+    uint32_t prev;
+    uint32_t next;
+} cache_manager_lfu_bucket_t;
+
+typedef struct cache_manager_timer_s {
+    uint32_t expire_tick;
+    uint32_t bucket; /* timer wheel bucket */
+    uint32_t prev;
+    uint32_t next;
+} cache_manager_timer_t;
+
+#define CACHE_MANAGER_HIST_BUCKET_NUM 32
+
+#define CACHE_MANAGER_TIMER_SLOT_BITS 6
+#define CACHE_MANAGER_TIMER_SLOT_NUM (1 << CACHE_MANAGER_TIMER_SLOT_BITS)
+#define CACHE_MANAGER_TIMER_LEVEL_NUM 4
+#define CACHE_MANAGER_TIMER_BUCKET_NUM (CACHE_MANAGER_TIMER_SLOT_NUM * CACHE_MANAGER_TIMER_LEVEL_NUM)
+
+typedef struct cache_manager_stats_s {
+    uint64_t open_cnt;
+    uint64_t hit_cnt;
+    uint64_t miss_cnt; /* L1 misses, l2_hit_cnt of them served by L2 */
+    uint64_t evict_cnt;
+    uint64_t invalidate_cnt;
+    uint64_t create_fail_cnt;
+    uint64_t expire_cnt;
+    uint64_t l2_hit_cnt;
+    uint64_t l2_spill_cnt; /* evicted nodes kept by L2 */
+    uint64_t mode_switch_cnt;
+
+    /* log2 histograms in ticks: bucket i counts values in [2^(i-1), 2^i),
+     * bucket 0 counts 0. Filled only when tick_get_cb is set. */
+    uint64_t open_time_hist[CACHE_MANAGER_HIST_BUCKET_NUM]; /* create_cb latency */
+    uint64_t lifetime_hist[CACHE_MANAGER_HIST_BUCKET_NUM]; /* insert to eviction or invalidation */
+} cache_manager_stats_t;
+
 typedef struct cache_manager_s {
     cache_manager_node_t* cache_node_array;
     uint32_t cache_num;
-    uint32_t cache_hit_cnt;
-    uint32_t cache_open_cnt;
+
+    cache_manager_index_t index;
+    int* id_array; /* packed ids by slot, when the hash index is disabled */
+    cache_manager_key_entry_t* key_table; /* key mode only */
+    uint32_t key_mask;
+    cache_manager_key_t* key_array; /* keys by slot, then the one of the node being created */
+
+    uint32_t* free_slot_array;
+    uint32_t free_slot_cnt;
+    uint32_t tombstone_cnt; /* FIFO slots invalidated before the tail got to them */
+    uint32_t pin_node_cnt;
+
+    cache_manager_list_t lru_list;
+    uint32_t* heap_array;
+    uint32_t heap_cnt;
+    uint32_t life_epoch;
+
+    cache_manager_lfu_bucket_t* lfu_bucket_array;
+    uint32_t lfu_bucket_head;
+    uint32_t lfu_bucket_free;
+    uint32_t lfu_age;
+
+    uint64_t* gdsf_priority_array;
+    uint64_t gdsf_age;
+
+    uint64_t cache_bytes;
+    uint64_t byte_limit;
+
+    cache_manager_list_t seg_list[CACHE_MANAGER_SEG_NUM];
+
+    cache_manager_ghost_t* ghost_array;
+    cache_manager_index_t ghost_index;
+    cache_manager_list_t ghost_list[2];
+    uint32_t ghost_free;
+    uint32_t arc_p;
+    uint32_t arc_ghost_hit;
+
+    uint64_t* sketch_array;
+    uint32_t sketch_mask;
+    uint32_t sketch_sample_cnt;
+    uint32_t sketch_sample_limit;
+
+    uint32_t* clock_ref_bitmap;
+
+    cache_manager_stats_t stats;
+    uint32_t* attach_tick_array; /* insert ticks by slot for lifetime_hist, with tick_get_cb only */
+    cache_manager_list_t* timer_wheel; /* allocated on first TTL */
+    cache_manager_timer_t* timer_array; /* wheel links by slot, allocated with timer_wheel */
+    uint32_t timer_tick;
+    uint32_t timer_cnt;
+    uint32_t timer_level_cnt[CACHE_MANAGER_TIMER_LEVEL_NUM];
+    uint32_t default_ttl;
+
+    struct cache_manager_mrc_s* mrc; /* miss ratio curve estimator, see cache_manager_mrc.h */
+    struct cache_manager_adapt_s* adapt; /* adaptive mode selection, see cache_manager_adapt.h */
+    struct cache_manager_l2_s* l2; /* spill tier, see cache_manager_l2.h */
+    struct cache_manager_trace_s* trace; /* event ring, see cache_manager_trace.h */
+    uint16_t trace_source;
     uint32_t cache_head;
-    uint32_t cache_tail;
+    uint32_t cache_tail; /* also the clock hand */
     cache_manager_mode_t mode;
 
     cache_manager_user_cb_t create_cb;
     cache_manager_user_cb_t delete_cb;
     cache_manager_tick_get_cb_t tick_get_cb;
+    cache_manager_batch_cb_t batch_create_cb;
+    bool recycle;
+    bool lock_free_hit; /* set by the shard, the arrays cm_find_optimistic() reads must stay put */
 
     void* user_data;
 } cache_manager_t;
@@ -94,14 +254,138 @@ cache_manager_t* cm_create(
     cache_manager_user_cb_t delete_cb,
     cache_manager_tick_get_cb_t tick_get_cb,
     void* user_data);
-void cm_set_cache_num(cache_manager_t* cm, uint32_t cache_num);
+/* Resize without flushing: growing keeps every entry, shrinking evicts
+ * with the active policy until the rest fits. Pointers to nodes are
+ * invalidated, so CACHE_MANAGER_RES_ERR_PINNED is returned while any
+ * node is pinned. */
+cache_manager_res_t cm_set_cache_num(cache_manager_t* cm, uint32_t cache_num);
+/* Limit the sum of context.size of resident nodes, 0 means no limit.
+ * Misses evict as many nodes as needed to fit the new one. */
+void cm_set_byte_limit(cache_manager_t* cm, uint64_t byte_limit);
+/* Switches the eviction policy in place: resident nodes are kept and
+ * handed to the new policy in the eviction order of the old one. Switching
+ * to FIFO moves nodes, so it returns CACHE_MANAGER_RES_ERR_PINNED while any
+ * node is pinned and CACHE_MANAGER_RES_ERR_MODE while TTLs are in use. */
+cache_manager_res_t cm_set_mode(cache_manager_t* cm, cache_manager_mode_t mode);
 void cm_delete(cache_manager_t* cm);
 cache_manager_res_t cm_open(cache_manager_t* cm, int id, cache_manager_node_t** node_p);
 cache_manager_res_t cm_invalidate(cache_manager_t* cm, int id);
+/* Bulk invalidation in one pass, returning how many resident nodes were
+ * dropped; pinned ones stay and copies in L2 are dropped too.
+ * cm_invalidate_if() asks predicate about every resident node, it must not
+ * call back into cm. In FIFO mode freed slots stay in the ring as
+ * tombstones until the eviction hand reaches them, so that new nodes keep
+ * their place in the insertion order. When they pile up, the next eviction
+ * compacts the ring instead, which moves the unpinned nodes. */
+uint32_t cm_invalidate_many(cache_manager_t* cm, const int* id_array, uint32_t num);
+uint32_t cm_invalidate_if(cache_manager_t* cm, cache_manager_predicate_cb_t predicate, void* user_data);
+
+/* Open num ids at once. Hits are resolved in one pass, then the distinct
+ * missing ids are created together by the batch create callback (or by
+ * create_cb one by one when none is set) and installed. A later miss never
+ * evicts a node opened earlier in the same batch. The outcome of each id
+ * goes to node_array[i] and res_array[i], the first failure is returned. */
+cache_manager_res_t cm_open_many(cache_manager_t* cm, const int* id_array, uint32_t num, cache_manager_node_t** node_array, cache_manager_res_t* res_array);
+/* The callback gets nodes with only cache_manager and id set, it fills their
+ * context like create_cb and reports each one in success_array. */
+void cm_set_batch_create_cb(cache_manager_t* cm, cache_manager_batch_cb_t batch_create_cb);
+
+/* Recycle mode: when cm_open() misses on a full cache, the victim is
+ * evicted first and, instead of going to delete_cb, its context.ptr and
+ * context.size are preset in the node passed to create_cb. create_cb owns
+ * that buffer: it reuses it when the size fits, or frees it, also when it
+ * fails. Without a victim, create_cb gets ptr NULL and size 0 as usual. */
+void cm_set_recycle(cache_manager_t* cm, bool recycle);
+
+/* Time to live in tick_get_cb() ticks, 0 means forever. The default TTL
+ * applies to nodes inserted afterwards, cm_set_ttl() restarts the TTL of
+ * one resident node. An expired node is a miss for cm_open() and is
+ * reclaimed through a timer wheel, when misses need room or when
+ * cm_expire_tick() is called, which returns how many nodes expired.
+ * Pinned nodes outlive their TTL until released. Not supported in FIFO. */
+cache_manager_res_t cm_set_default_ttl(cache_manager_t* cm, uint32_t ttl);
+cache_manager_res_t cm_set_ttl(cache_manager_t* cm, cache_manager_node_t* node, uint32_t ttl);
+uint32_t cm_expire_tick(cache_manager_t* cm);
+
+/* Key mode: nodes are opened by uint64_t or byte string keys instead of
+ * int ids. It can only be switched while the cache is empty and it excludes
+ * the int id API, cm_open_many(), the L2 tier and snapshots: the int id
+ * calls return CACHE_MANAGER_RES_ERR_MODE (cm_peek() NULL, cm_invalidate_many()
+ * 0) while it is on. Keys are kept by slot in an array allocated by
+ * cm_set_key_mode(), so that nodes don't grow outside of key mode. Keys up
+ * to CACHE_MANAGER_KEY_INLINE_SIZE bytes are stored in the array, longer
+ * ones are copied to the heap. Lookups go through a hash table of
+ * fingerprints, the key bytes are compared only on a fingerprint match.
+ * Each keyed node still gets an int id derived from its hash, unique among
+ * the resident nodes, which the policies and stats use. A key length of 0
+ * is invalid. */
+cache_manager_res_t cm_set_key_mode(cache_manager_t* cm, bool key_mode);
+cache_manager_res_t cm_open_key(cache_manager_t* cm, const void* key, uint32_t len, cache_manager_node_t** node_p);
+cache_manager_res_t cm_acquire_key(cache_manager_t* cm, const void* key, uint32_t len, cache_manager_node_t** node_p);
+cache_manager_res_t cm_invalidate_key(cache_manager_t* cm, const void* key, uint32_t len);
+cache_manager_node_t* cm_peek_key(cache_manager_t* cm, const void* key, uint32_t len);
+cache_manager_res_t cm_open_u64(cache_manager_t* cm, uint64_t key, cache_manager_node_t** node_p);
+cache_manager_res_t cm_invalidate_u64(cache_manager_t* cm, uint64_t key);
+cache_manager_node_t* cm_peek_u64(cache_manager_t* cm, uint64_t key);
+/* The key of a node, e.g. for create_cb, NULL for nodes opened by int id */
+const void* cm_node_get_key(const cache_manager_node_t* node, uint32_t* len);
+
+/* Like cm_open(), but the node is pinned: it won't be evicted or
+ * invalidated until cm_release(). When every node is pinned, a miss
+ * returns CACHE_MANAGER_RES_ERR_PINNED. Release pinned nodes before
+ * cm_clear() or cm_delete(), which close them anyway and drop their pins.
+ * cm_pin() pins an already opened node. */
+cache_manager_res_t cm_acquire(cache_manager_t* cm, int id, cache_manager_node_t** node_p);
+void cm_pin(cache_manager_t* cm, cache_manager_node_t* node);
+void cm_release(cache_manager_t* cm, cache_manager_node_t* node);
+
+/* cm_open() split into its steps, for callers that run create_cb outside
+ * of their own lock: cm_lookup() only counts and touches hits,
+ * cm_load() runs create_cb into a detached node without modifying cm (it
+ * does not look into L2), cm_insert() counts the load and installs the node,
+ * evicting a victim if needed, cm_load_failed() counts a failed cm_load()
+ * once the lock is held again.
+ * cm_peek() finds a resident node without updating any state. */
+cache_manager_res_t cm_lookup(cache_manager_t* cm, int id, cache_manager_node_t** node_p);
+cache_manager_res_t cm_load(cache_manager_t* cm, int id, cache_manager_node_t* node);
+void cm_load_failed(cache_manager_t* cm, int id);
+cache_manager_res_t cm_insert(cache_manager_t* cm, cache_manager_node_t* node, cache_manager_node_t** node_p);
+cache_manager_node_t* cm_peek(cache_manager_t* cm, int id);
 void cm_clear(cache_manager_t* cm);
 
+/* Lock-free hits, see cm_shard_set_lock_free_hit(): cm_find_optimistic()
+ * looks id up without writing anything, its result only holds if no writer
+ * ran meanwhile, which the caller checks with a sequence count. Nodes with
+ * a deadline are never returned. cm_replay_hit() later counts such a hit
+ * and touches the node at slot, unless it was reused in the meantime.
+ * A reader may still be probing index.table (id_array without the hash
+ * index) and cache_node_array after a writer took over, which is only safe
+ * because they are never reallocated meanwhile: while lock_free_hit is set,
+ * cm_set_cache_num(), cm_set_mode() and cm_set_key_mode() fail with
+ * CACHE_MANAGER_RES_ERR_MODE. */
+cache_manager_node_t* cm_find_optimistic(cache_manager_t* cm, int id);
+void cm_replay_hit(cache_manager_t* cm, int id, uint32_t slot);
+
+/* Fills slot_array (cache_num entries) with the resident slots in the order
+ * the policy would evict them, the next victim first. Returns the count. */
+uint32_t cm_get_evict_order(cache_manager_t* cm, uint32_t* slot_array);
+
+/* Warm start: creates state->id through create_cb if there is a free slot
+ * and room in the byte limit, without evicting anything, and restores the
+ * saved priv.life, priv.ref_cnt and priv.time_to_open (life relative to
+ * the aging of LIFE, ref_cnt as the frequency above the age in LFU, like
+ * the snapshot module saves them). Nodes are expected from the hottest
+ * down, each one lands behind the resident nodes of its policy structure.
+ * FIFO and CLOCK go by slot order, they are expected from the coldest up.
+ * Returns CACHE_MANAGER_RES_ERR_FULL once the cache can't take more. */
+cache_manager_res_t cm_restore(cache_manager_t* cm, const cache_manager_node_t* state);
+
 int cm_get_cache_hit_rate(cache_manager_t* cm);
+/* Resets every counter of cm_get_stats() */
 void cm_reset_cache_hit_cnt(cache_manager_t* cm);
+void cm_get_stats(cache_manager_t* cm, cache_manager_stats_t* stats);
+/* Adds src to dst, e.g. to sum the stats of several caches */
+void cm_stats_merge(cache_manager_stats_t* dst, const cache_manager_stats_t* src);
 
 #ifdef __cplusplus
 }
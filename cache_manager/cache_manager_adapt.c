@@ -0,0 +1,285 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "cache_manager_adapt.h"
+#include "cache_manager_config.h"
+#include <string.h>
+
+#define CM_ADAPT_HASH_BITS 24
+
+/*Same floor as the miss ratio curve, smaller shadows are too noisy*/
+#define CM_ADAPT_SIM_NUM_MIN 64
+
+/*The window slides by quarters*/
+#define CM_ADAPT_SUB_WINDOW_NUM 4
+
+#define CM_ADAPT_MODE_NUM_MAX _CACHE_MANAGER_MODE_LAST
+
+typedef struct {
+    cache_manager_mode_t mode;
+    cache_manager_t* sim;
+    uint32_t hit_array[CM_ADAPT_SUB_WINDOW_NUM];
+} cm_adapt_shadow_t;
+
+struct cache_manager_adapt_s {
+    cm_adapt_shadow_t shadow_array[CM_ADAPT_MODE_NUM_MAX];
+    uint32_t shadow_num;
+    uint32_t threshold;
+    uint32_t sub_window_size;
+    uint32_t sub_window;
+    uint32_t access_cnt; /* in the current sub-window */
+    uint32_t sub_window_cnt; /* complete ones since the last switch */
+    uint32_t filled_cnt; /* complete ones in the window */
+    uint32_t margin;
+};
+
+static bool cm_adapt_create_cb(cache_manager_node_t* node)
+{
+    return true;
+}
+
+static uint32_t cm_adapt_hash(int id)
+{
+    uint32_t h = (uint32_t)id * 0x9E3779B1;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6D;
+    h ^= h >> 12;
+    return h & ((1u << CM_ADAPT_HASH_BITS) - 1);
+}
+
+static bool cm_adapt_add_shadow(cache_manager_adapt_t* adapt, cache_manager_mode_t mode, uint32_t sim_cache_num)
+{
+    for (uint32_t i = 0; i < adapt->shadow_num; i++) {
+        if (adapt->shadow_array[i].mode == mode) {
+            return true;
+        }
+    }
+
+    cm_adapt_shadow_t* shadow = &adapt->shadow_array[adapt->shadow_num];
+    shadow->mode = mode;
+    shadow->sim = cm_create(sim_cache_num, mode, cm_adapt_create_cb, NULL, NULL, NULL);
+
+    if (!shadow->sim) {
+        return false;
+    }
+
+    adapt->shadow_num++;
+    return true;
+}
+
+bool cm_adapt_enable(
+    cache_manager_t* cm,
+    const cache_manager_mode_t* mode_array,
+    uint32_t num,
+    uint32_t sample_shift,
+    uint32_t window_size,
+    uint32_t margin)
+{
+    static const cache_manager_mode_t default_mode_array[] = {
+        CACHE_MANAGER_MODE_FIFO,
+        CACHE_MANAGER_MODE_LRU,
+        CACHE_MANAGER_MODE_LFU,
+        CACHE_MANAGER_MODE_LIFE,
+    };
+
+    cm_adapt_disable(cm);
+
+    if (!mode_array) {
+        mode_array = default_mode_array;
+        num = sizeof(default_mode_array) / sizeof(default_mode_array[0]);
+    }
+
+    if (num == 0 || sample_shift >= CM_ADAPT_HASH_BITS || window_size < CM_ADAPT_SUB_WINDOW_NUM) {
+        return false;
+    }
+
+    cache_manager_adapt_t* adapt = CACHE_MANAGER_MALLOC(sizeof(cache_manager_adapt_t));
+
+    if (!adapt) {
+        CM_LOG_ERROR("adapt malloc failed");
+        return false;
+    }
+
+    memset(adapt, 0, sizeof(cache_manager_adapt_t));
+    cm->adapt = adapt;
+
+    while (sample_shift > 0 && (cm->cache_num >> sample_shift) < CM_ADAPT_SIM_NUM_MIN) {
+        sample_shift--;
+    }
+
+    /*FIFO needs two nodes to evict*/
+    uint32_t sim_cache_num = cm->cache_num >> sample_shift;
+    if (sim_cache_num < 2) {
+        sim_cache_num = 2;
+    }
+
+    adapt->threshold = (1u << CM_ADAPT_HASH_BITS) >> sample_shift;
+    adapt->sub_window_size = window_size / CM_ADAPT_SUB_WINDOW_NUM;
+    adapt->margin = margin;
+
+    if (!cm_adapt_add_shadow(adapt, cm->mode, sim_cache_num)) {
+        goto failed;
+    }
+
+    for (uint32_t i = 0; i < num; i++) {
+        if (mode_array[i] >= _CACHE_MANAGER_MODE_LAST || !cm_adapt_add_shadow(adapt, mode_array[i], sim_cache_num)) {
+            goto failed;
+        }
+    }
+
+    return true;
+
+failed:
+    cm_adapt_disable(cm);
+    return false;
+}
+
+void cm_adapt_disable(cache_manager_t* cm)
+{
+    cache_manager_adapt_t* adapt = cm->adapt;
+
+    if (!adapt) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < adapt->shadow_num; i++) {
+        cm_delete(adapt->shadow_array[i].sim);
+    }
+
+    CACHE_MANAGER_FREE(adapt);
+    cm->adapt = NULL;
+}
+
+static uint32_t cm_adapt_get_hit_cnt(cm_adapt_shadow_t* shadow)
+{
+    uint32_t hit_cnt = 0;
+
+    for (uint32_t i = 0; i < CM_ADAPT_SUB_WINDOW_NUM; i++) {
+        hit_cnt += shadow->hit_array[i];
+    }
+
+    return hit_cnt;
+}
+
+static void cm_adapt_decide(cache_manager_t* cm)
+{
+    cache_manager_adapt_t* adapt = cm->adapt;
+    cm_adapt_shadow_t* current = NULL;
+    cm_adapt_shadow_t* best = NULL;
+
+    for (uint32_t i = 0; i < adapt->shadow_num; i++) {
+        cm_adapt_shadow_t* shadow = &adapt->shadow_array[i];
+
+        if (shadow->mode == cm->mode) {
+            current = shadow;
+        }
+
+        if (!best || cm_adapt_get_hit_cnt(shadow) > cm_adapt_get_hit_cnt(best)) {
+            best = shadow;
+        }
+    }
+
+    if (!current || best == current) {
+        return;
+    }
+
+    /*Only a clear win is worth the switch, hit counts are over the same window*/
+    uint64_t window_size = (uint64_t)adapt->sub_window_size * CM_ADAPT_SUB_WINDOW_NUM;
+    uint64_t gain = cm_adapt_get_hit_cnt(best) - cm_adapt_get_hit_cnt(current);
+
+    if (gain * 1000 <= adapt->margin * window_size) {
+        return;
+    }
+
+    if (cm_set_mode(cm, best->mode) == CACHE_MANAGER_RES_OK) {
+        adapt->sub_window_cnt = 0;
+    }
+}
+
+void cm_adapt_access(cache_manager_t* cm, int id)
+{
+    cache_manager_adapt_t* adapt = cm->adapt;
+
+    if (cm_adapt_hash(id) >= adapt->threshold) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < adapt->shadow_num; i++) {
+        cm_adapt_shadow_t* shadow = &adapt->shadow_array[i];
+        uint64_t hit_cnt = shadow->sim->stats.hit_cnt;
+        cache_manager_node_t* node;
+
+        cm_open(shadow->sim, id, &node);
+        shadow->hit_array[adapt->sub_window] += (uint32_t)(shadow->sim->stats.hit_cnt - hit_cnt);
+    }
+
+    if (++adapt->access_cnt < adapt->sub_window_size) {
+        return;
+    }
+
+    /*A sub-window is complete: decide on the whole window, then drop its oldest quarter*/
+    adapt->access_cnt = 0;
+
+    if (adapt->sub_window_cnt < CM_ADAPT_SUB_WINDOW_NUM) {
+        adapt->sub_window_cnt++;
+    }
+
+    if (adapt->filled_cnt < CM_ADAPT_SUB_WINDOW_NUM - 1) {
+        adapt->filled_cnt++;
+    }
+
+    if (adapt->sub_window_cnt == CM_ADAPT_SUB_WINDOW_NUM) {
+        cm_adapt_decide(cm);
+    }
+
+    adapt->sub_window = (adapt->sub_window + 1) % CM_ADAPT_SUB_WINDOW_NUM;
+
+    for (uint32_t i = 0; i < adapt->shadow_num; i++) {
+        adapt->shadow_array[i].hit_array[adapt->sub_window] = 0;
+    }
+}
+
+uint32_t cm_adapt_get(cache_manager_t* cm, cache_manager_adapt_point_t* point_array, uint32_t num)
+{
+    cache_manager_adapt_t* adapt = cm->adapt;
+
+    if (!adapt) {
+        return 0;
+    }
+
+    if (num > adapt->shadow_num) {
+        num = adapt->shadow_num;
+    }
+
+    /*The current sub-window is still filling*/
+    uint64_t window_size = (uint64_t)adapt->sub_window_size * adapt->filled_cnt + adapt->access_cnt;
+
+    for (uint32_t i = 0; i < num; i++) {
+        cm_adapt_shadow_t* shadow = &adapt->shadow_array[i];
+        point_array[i].mode = shadow->mode;
+        point_array[i].hit_rate = window_size > 0 ? (int)(cm_adapt_get_hit_cnt(shadow) * 1000 / window_size) : 0;
+    }
+
+    return num;
+}
@@ -0,0 +1,66 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CACHE_MANAGER_ADAPT_H__
+#define __CACHE_MANAGER_ADAPT_H__
+
+#include "cache_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cache_manager_adapt_s cache_manager_adapt_t;
+
+typedef struct cache_manager_adapt_point_s {
+    cache_manager_mode_t mode;
+    int hit_rate; /* over the last window, in permille */
+} cache_manager_adapt_point_t;
+
+/* Adaptive policy: the ids passed to cm_open() are sampled by hash at a
+ * rate of 1 / 2^sample_shift and replayed into metadata-only shadow caches,
+ * one per candidate mode, scaled down by the same rate (at least 64 nodes).
+ * Their hit rates are tracked over a sliding window of window_size sampled
+ * opens, and once a window has passed since the last switch, cm_set_mode()
+ * moves the cache to a shadow that beats the shadow of the current mode by
+ * more than margin permille. mode_array NULL stands for FIFO, LRU, LFU and
+ * LIFE, the current mode is always one of the candidates. */
+bool cm_adapt_enable(
+    cache_manager_t* cm,
+    const cache_manager_mode_t* mode_array,
+    uint32_t num,
+    uint32_t sample_shift,
+    uint32_t window_size,
+    uint32_t margin);
+void cm_adapt_disable(cache_manager_t* cm);
+/* Fills up to num points, one per candidate, returns how many were filled */
+uint32_t cm_adapt_get(cache_manager_t* cm, cache_manager_adapt_point_t* point_array, uint32_t num);
+
+/* Called by cm_open() for every valid id when adaptation is enabled */
+void cm_adapt_access(cache_manager_t* cm, int id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CACHE_MANAGER_ADAPT_H__ */
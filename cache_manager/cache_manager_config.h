@@ -28,19 +28,101 @@
 #include <stdlib.h>
 
 /*Enable log*/
+#ifndef CACHE_MANAGER_USE_LOG
 #define CACHE_MANAGER_USE_LOG 1
+#endif
+
+#define CACHE_MANAGER_LOG_LEVEL_NONE 0
+#define CACHE_MANAGER_LOG_LEVEL_ERROR 1
+#define CACHE_MANAGER_LOG_LEVEL_WARN 2
+#define CACHE_MANAGER_LOG_LEVEL_INFO 3
 
+/*Messages above this level are compiled out. Info is traced on the hit
+ *path, so it is off by default, see cache_manager_trace.h for a cheap way
+ *to follow every access*/
+#ifndef CACHE_MANAGER_LOG_LEVEL
 #if CACHE_MANAGER_USE_LOG
+#define CACHE_MANAGER_LOG_LEVEL CACHE_MANAGER_LOG_LEVEL_WARN
+#else
+#define CACHE_MANAGER_LOG_LEVEL CACHE_MANAGER_LOG_LEVEL_NONE
+#endif
+#endif
+
 #define CM_LOG(format, ...) printf("[CM]" format "\r\n", ##__VA_ARGS__)
+
+#if CACHE_MANAGER_LOG_LEVEL >= CACHE_MANAGER_LOG_LEVEL_INFO
 #define CM_LOG_INFO(format, ...) CM_LOG("[Info] " format, ##__VA_ARGS__)
-#define CM_LOG_WARN(format, ...) CM_LOG("[Warn] " format, ##__VA_ARGS__)
-#define CM_LOG_ERROR(format, ...) CM_LOG("[Error] " format, ##__VA_ARGS__)
 #else
 #define CM_LOG_INFO(...)
+#endif
+
+#if CACHE_MANAGER_LOG_LEVEL >= CACHE_MANAGER_LOG_LEVEL_WARN
+#define CM_LOG_WARN(format, ...) CM_LOG("[Warn] " format, ##__VA_ARGS__)
+#else
 #define CM_LOG_WARN(...)
+#endif
+
+#if CACHE_MANAGER_LOG_LEVEL >= CACHE_MANAGER_LOG_LEVEL_ERROR
+#define CM_LOG_ERROR(format, ...) CM_LOG("[Error] " format, ##__VA_ARGS__)
+#else
 #define CM_LOG_ERROR(...)
 #endif
 
+/*Binary event tracing, see cache_manager_trace.h. Without it the hooks
+ *compile out and cm_set_trace() is a no-op*/
+#ifndef CACHE_MANAGER_USE_TRACE
+#define CACHE_MANAGER_USE_TRACE 1
+#endif
+
+/*Use an open-addressing hash index (id -> slot) instead of scanning the node array*/
+#ifndef CACHE_MANAGER_USE_HASH
+#define CACHE_MANAGER_USE_HASH 1
+#endif
+
+/*Without the hash index, keep the ids in their own packed array and search
+ *it with SSE2/AVX2 when the compiler targets them (e.g. -mavx2)*/
+#ifndef CACHE_MANAGER_USE_SIMD
+#define CACHE_MANAGER_USE_SIMD 1
+#endif
+
+/*LFU dynamic aging: new entries start from the frequency of the last victim,
+ *so that the popularity of entries which are no longer used fades away*/
+#define CACHE_MANAGER_LFU_USE_AGING 1
+
+/*Shards of cache_manager_shard_t are padded to this size to avoid false sharing*/
+#define CACHE_MANAGER_CACHE_LINE_SIZE 64
+
+/*Lock-free hits of cache_manager_shard_t: read buffers per shard, threads
+ *are spread over them, and the number of hits each one holds until they
+ *are replayed into the policy (a power of 2)*/
+#define CACHE_MANAGER_READ_BUFFER_NUM 4
+#define CACHE_MANAGER_READ_BUFFER_SIZE 64
+
+/*Atomics of the lock-free paths, relaxed unless stated otherwise*/
+#if defined(__GNUC__)
+#define CM_ATOMIC_LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define CM_ATOMIC_LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define CM_ATOMIC_STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#define CM_ATOMIC_STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define CM_ATOMIC_FETCH_ADD(ptr, val) __atomic_fetch_add(ptr, val, __ATOMIC_RELAXED)
+#define CM_ATOMIC_CAS(ptr, expected_ptr, val) \
+    __atomic_compare_exchange_n(ptr, expected_ptr, val, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define CM_ATOMIC_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define CM_ATOMIC_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define CM_THREAD_LOCAL __thread
+#else
+/*Without atomics the lock-free paths are only safe on a single thread*/
+#define CM_ATOMIC_LOAD(ptr) (*(ptr))
+#define CM_ATOMIC_LOAD_ACQUIRE(ptr) (*(ptr))
+#define CM_ATOMIC_STORE(ptr, val) (*(ptr) = (val))
+#define CM_ATOMIC_STORE_RELEASE(ptr, val) (*(ptr) = (val))
+#define CM_ATOMIC_FETCH_ADD(ptr, val) ((*(ptr) += (val)) - (val))
+#define CM_ATOMIC_CAS(ptr, expected_ptr, val) (*(ptr) == *(expected_ptr) ? (*(ptr) = (val), true) : (*(expected_ptr) = *(ptr), false))
+#define CM_ATOMIC_FENCE_ACQUIRE()
+#define CM_ATOMIC_FENCE_RELEASE()
+#define CM_THREAD_LOCAL
+#endif
+
 #define CACHE_MANAGER_MALLOC(size) malloc(size)
 #define CACHE_MANAGER_REALLOC(ptr, size) realloc(ptr, size)
 #define CACHE_MANAGER_FREE(ptr) free(ptr)
@@ -0,0 +1,340 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "cache_manager_l2.h"
+#include "cache_manager_config.h"
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define CM_L2_NONE UINT32_MAX
+
+/*One payload in the ring log, id 0 once it was taken back or invalidated*/
+typedef struct {
+    int id;
+    uint32_t size;
+    uint64_t offset;
+} cm_l2_entry_t;
+
+struct cache_manager_l2_s {
+    uint8_t* map;
+    uint64_t map_size;
+    uint64_t write_offset;
+
+    /*Entries in the order they were written, the oldest at entry_head*/
+    cm_l2_entry_t* entry_array;
+    uint32_t entry_num;
+    uint32_t entry_head;
+    uint32_t entry_cnt;
+    uint32_t live_cnt;
+
+    /*id -> entry position, open addressing*/
+    uint32_t* table;
+    uint32_t table_mask;
+
+    cache_manager_serialize_cb_t serialize_cb;
+    cache_manager_deserialize_cb_t deserialize_cb;
+};
+
+static uint32_t cm_l2_hash(int id)
+{
+    uint32_t h = (uint32_t)id;
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t cm_l2_table_find(cache_manager_l2_t* l2, int id)
+{
+    uint32_t pos = cm_l2_hash(id) & l2->table_mask;
+
+    while (l2->table[pos] != CM_L2_NONE) {
+        if (l2->entry_array[l2->table[pos]].id == id) {
+            return pos;
+        }
+        pos = (pos + 1) & l2->table_mask;
+    }
+
+    return CM_L2_NONE;
+}
+
+static void cm_l2_table_insert(cache_manager_l2_t* l2, int id, uint32_t entry)
+{
+    uint32_t pos = cm_l2_hash(id) & l2->table_mask;
+
+    while (l2->table[pos] != CM_L2_NONE) {
+        pos = (pos + 1) & l2->table_mask;
+    }
+
+    l2->table[pos] = entry;
+}
+
+static void cm_l2_table_remove(cache_manager_l2_t* l2, uint32_t pos)
+{
+    uint32_t mask = l2->table_mask;
+
+    /*Backward shift deletion, like the index of cache_manager.c*/
+    uint32_t next = (pos + 1) & mask;
+    while (l2->table[next] != CM_L2_NONE) {
+        uint32_t home = cm_l2_hash(l2->entry_array[l2->table[next]].id) & mask;
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            l2->table[pos] = l2->table[next];
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    l2->table[pos] = CM_L2_NONE;
+}
+
+static void cm_l2_drop(cache_manager_l2_t* l2, uint32_t pos)
+{
+    /*The bytes stay in the log until the writer wraps over them*/
+    cm_l2_entry_t* entry = &l2->entry_array[l2->table[pos]];
+    cm_l2_table_remove(l2, pos);
+    entry->id = CACHE_MANAGER_INVALIDATE_ID;
+    l2->live_cnt--;
+}
+
+static cm_l2_entry_t* cm_l2_get_oldest(cache_manager_l2_t* l2)
+{
+    return l2->entry_cnt > 0 ? &l2->entry_array[l2->entry_head] : NULL;
+}
+
+static void cm_l2_pop_oldest(cache_manager_l2_t* l2)
+{
+    cm_l2_entry_t* entry = &l2->entry_array[l2->entry_head];
+
+    if (entry->id != CACHE_MANAGER_INVALIDATE_ID) {
+        cm_l2_drop(l2, cm_l2_table_find(l2, entry->id));
+    }
+
+    l2->entry_head = (l2->entry_head + 1) % l2->entry_num;
+    l2->entry_cnt--;
+}
+
+static uint64_t cm_l2_alloc(cache_manager_l2_t* l2, uint32_t size)
+{
+    /*Payloads are laid out one after another from the oldest, so the room
+     *ahead of the writer is taken from the oldest entries*/
+    if (l2->write_offset + size > l2->map_size) {
+        cm_l2_entry_t* oldest;
+        while ((oldest = cm_l2_get_oldest(l2)) && oldest->offset >= l2->write_offset) {
+            cm_l2_pop_oldest(l2);
+        }
+        l2->write_offset = 0;
+    }
+
+    cm_l2_entry_t* oldest;
+    while ((oldest = cm_l2_get_oldest(l2))
+        && oldest->offset >= l2->write_offset
+        && oldest->offset < l2->write_offset + size) {
+        cm_l2_pop_oldest(l2);
+    }
+
+    if (l2->entry_cnt == l2->entry_num) {
+        cm_l2_pop_oldest(l2);
+    }
+
+    uint64_t offset = l2->write_offset;
+    l2->write_offset += size;
+    return offset;
+}
+
+bool cm_l2_enable(
+    cache_manager_t* cm,
+    const char* path,
+    uint64_t file_size,
+    uint32_t entry_num,
+    cache_manager_serialize_cb_t serialize_cb,
+    cache_manager_deserialize_cb_t deserialize_cb)
+{
+    cm_l2_disable(cm);
+
+    /*Entries are found by id, which keyed nodes only borrow*/
+    if (cm->key_table || file_size == 0 || entry_num == 0 || !serialize_cb || !deserialize_cb) {
+        return false;
+    }
+
+    cache_manager_l2_t* l2 = CACHE_MANAGER_MALLOC(sizeof(cache_manager_l2_t));
+
+    if (!l2) {
+        CM_LOG_ERROR("l2 malloc failed");
+        return false;
+    }
+
+    memset(l2, 0, sizeof(cache_manager_l2_t));
+    l2->map = MAP_FAILED;
+    l2->map_size = file_size;
+    l2->entry_num = entry_num;
+    l2->serialize_cb = serialize_cb;
+    l2->deserialize_cb = deserialize_cb;
+
+    uint32_t table_size = 8;
+    while (table_size < entry_num * 2) {
+        table_size <<= 1;
+    }
+    l2->table_mask = table_size - 1;
+
+    l2->entry_array = CACHE_MANAGER_MALLOC(sizeof(cm_l2_entry_t) * entry_num);
+    l2->table = CACHE_MANAGER_MALLOC(sizeof(uint32_t) * table_size);
+
+    if (!l2->entry_array || !l2->table) {
+        CM_LOG_ERROR("l2 index malloc failed");
+        goto failed;
+    }
+
+    memset(l2->table, 0xFF, sizeof(uint32_t) * table_size);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if (fd < 0) {
+        CM_LOG_ERROR("can't create %s", path);
+        goto failed;
+    }
+
+    if (ftruncate(fd, (off_t)file_size) == 0) {
+        l2->map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    /*The mapping keeps the file alive, nothing is left behind on exit*/
+    close(fd);
+    unlink(path);
+
+    if (l2->map == MAP_FAILED) {
+        CM_LOG_ERROR("can't map %" PRIu64 " bytes of %s", file_size, path);
+        goto failed;
+    }
+
+    cm->l2 = l2;
+    CM_LOG_INFO("l2 enabled, %" PRIu64 " bytes, %" PRIu32 " entries", file_size, entry_num);
+    return true;
+
+failed:
+    CACHE_MANAGER_FREE(l2->table);
+    CACHE_MANAGER_FREE(l2->entry_array);
+    CACHE_MANAGER_FREE(l2);
+    return false;
+}
+
+void cm_l2_disable(cache_manager_t* cm)
+{
+    cache_manager_l2_t* l2 = cm->l2;
+
+    if (!l2) {
+        return;
+    }
+
+    munmap(l2->map, l2->map_size);
+    CACHE_MANAGER_FREE(l2->table);
+    CACHE_MANAGER_FREE(l2->entry_array);
+    CACHE_MANAGER_FREE(l2);
+    cm->l2 = NULL;
+}
+
+uint32_t cm_l2_get_entry_cnt(cache_manager_t* cm)
+{
+    return cm->l2 ? cm->l2->live_cnt : 0;
+}
+
+bool cm_l2_spill(cache_manager_t* cm, const cache_manager_node_t* node)
+{
+    cache_manager_l2_t* l2 = cm->l2;
+    uint32_t size = l2->serialize_cb(node, NULL, 0);
+
+    if (size == 0 || size > l2->map_size) {
+        return false;
+    }
+
+    /*A stale copy can't be left behind the new one*/
+    cm_l2_remove(cm, node->id);
+
+    uint64_t offset = cm_l2_alloc(l2, size);
+
+    if (l2->serialize_cb(node, l2->map + offset, size) != size) {
+        CM_LOG_WARN("id:%d serialized size changed", node->id);
+        l2->write_offset = offset;
+        return false;
+    }
+
+    uint32_t entry_pos = (l2->entry_head + l2->entry_cnt) % l2->entry_num;
+    cm_l2_entry_t* entry = &l2->entry_array[entry_pos];
+
+    entry->id = node->id;
+    entry->size = size;
+    entry->offset = offset;
+    l2->entry_cnt++;
+    l2->live_cnt++;
+    cm_l2_table_insert(l2, node->id, entry_pos);
+    return true;
+}
+
+bool cm_l2_load(cache_manager_t* cm, cache_manager_node_t* node)
+{
+    cache_manager_l2_t* l2 = cm->l2;
+    uint32_t pos = cm_l2_table_find(l2, node->id);
+
+    if (pos == CM_L2_NONE) {
+        return false;
+    }
+
+    cm_l2_entry_t* entry = &l2->entry_array[l2->table[pos]];
+    bool success = l2->deserialize_cb(node, l2->map + entry->offset, entry->size);
+
+    /*Moved back to L1 or unusable, the copy goes either way*/
+    cm_l2_drop(l2, pos);
+
+    if (!success) {
+        CM_LOG_WARN("id:%d deserialize failed", node->id);
+    }
+
+    return success;
+}
+
+bool cm_l2_remove(cache_manager_t* cm, int id)
+{
+    cache_manager_l2_t* l2 = cm->l2;
+    uint32_t pos = cm_l2_table_find(l2, id);
+
+    if (pos == CM_L2_NONE) {
+        return false;
+    }
+
+    cm_l2_drop(l2, pos);
+    return true;
+}
+
+void cm_l2_clear(cache_manager_t* cm)
+{
+    cache_manager_l2_t* l2 = cm->l2;
+
+    memset(l2->table, 0xFF, sizeof(uint32_t) * (l2->table_mask + 1));
+    l2->entry_head = l2->entry_cnt = l2->live_cnt = 0;
+    l2->write_offset = 0;
+}
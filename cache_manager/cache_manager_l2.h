@@ -0,0 +1,74 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CACHE_MANAGER_L2_H__
+#define __CACHE_MANAGER_L2_H__
+
+#include "cache_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cache_manager_l2_s cache_manager_l2_t;
+
+/* Writes the payload of node into buf, like snprintf: returns the size the
+ * payload needs, and only writes it when that fits in buf_size. It is first
+ * called with buf NULL to get the size. Returns 0 to not keep the node. */
+typedef uint32_t (*cache_manager_serialize_cb_t)(const cache_manager_node_t* node, void* buf, uint32_t buf_size);
+
+/* Rebuilds node->context from a payload, instead of create_cb and with the
+ * same contract (a recycled buffer may be preset). The payload is only
+ * valid during the call. */
+typedef bool (*cache_manager_deserialize_cb_t)(cache_manager_node_t* node, const void* buf, uint32_t size);
+
+/* Second tier for evicted nodes: their payloads are serialized into a file
+ * of file_size bytes mapped in memory, written as a ring log so the oldest
+ * payloads are dropped to make room, and indexed in memory for up to
+ * entry_num payloads. An L1 miss looks there before create_cb, a hit moves
+ * the payload back to L1. The file is unlinked right after it is mapped,
+ * it doesn't outlive the process. Nodes with a TTL are not spilled, and
+ * cm_invalidate()/cm_clear() drop the L2 copies too. See l2_hit_cnt and
+ * l2_spill_cnt in cache_manager_stats_t. */
+bool cm_l2_enable(
+    cache_manager_t* cm,
+    const char* path,
+    uint64_t file_size,
+    uint32_t entry_num,
+    cache_manager_serialize_cb_t serialize_cb,
+    cache_manager_deserialize_cb_t deserialize_cb);
+void cm_l2_disable(cache_manager_t* cm);
+/* Number of payloads held by the tier */
+uint32_t cm_l2_get_entry_cnt(cache_manager_t* cm);
+
+/* Called by cache_manager.c */
+bool cm_l2_spill(cache_manager_t* cm, const cache_manager_node_t* node);
+bool cm_l2_load(cache_manager_t* cm, cache_manager_node_t* node);
+bool cm_l2_remove(cache_manager_t* cm, int id);
+void cm_l2_clear(cache_manager_t* cm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CACHE_MANAGER_L2_H__ */
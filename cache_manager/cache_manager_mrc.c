@@ -0,0 +1,262 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cache_manager_mrc.h"
+#include "cache_manager_config.h"
+#include <string.h>
+
+#define CM_MRC_HASH_BITS 24
+
+/*Below this size a miniature cache gets too noisy, small capacities are
+ *sampled at a higher rate instead*/
+#define CM_MRC_SIM_NUM_MIN 64
+
+/*One simulated capacity: a miniature cache per simulated mode*/
+typedef struct {
+    uint32_t cache_num;
+    uint32_t sample_shift;
+    uint32_t threshold;
+    cache_manager_t* sim_array[2];
+} cm_mrc_sim_t;
+
+struct cache_manager_mrc_s {
+    cm_mrc_sim_t* sim_array;
+    uint32_t sim_num;
+    uint32_t sim_mode_num;
+    uint64_t access_cnt;
+};
+
+static bool cm_mrc_create_cb(cache_manager_node_t* node)
+{
+    return true;
+}
+
+static uint32_t cm_mrc_hash(int id)
+{
+    /*Independent of the hash index, so that sampling doesn't follow its buckets*/
+    uint32_t h = (uint32_t)id * 0x9E3779B1;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6D;
+    h ^= h >> 12;
+    return h & ((1u << CM_MRC_HASH_BITS) - 1);
+}
+
+bool cm_mrc_enable(cache_manager_t* cm, const uint32_t* cache_num_array, uint32_t num, uint32_t sample_shift)
+{
+    cm_mrc_disable(cm);
+
+    if (num == 0 || sample_shift >= CM_MRC_HASH_BITS) {
+        return false;
+    }
+
+    cache_manager_mrc_t* mrc = CACHE_MANAGER_MALLOC(sizeof(cache_manager_mrc_t));
+
+    if (!mrc) {
+        CM_LOG_ERROR("mrc malloc failed");
+        return false;
+    }
+
+    memset(mrc, 0, sizeof(cache_manager_mrc_t));
+    cm->mrc = mrc;
+
+    mrc->sim_array = CACHE_MANAGER_MALLOC(sizeof(cm_mrc_sim_t) * num);
+
+    if (!mrc->sim_array) {
+        CM_LOG_ERROR("mrc sim_array malloc failed");
+        goto failed;
+    }
+
+    memset(mrc->sim_array, 0, sizeof(cm_mrc_sim_t) * num);
+    mrc->sim_num = num;
+    mrc->sim_mode_num = (cm->mode == CACHE_MANAGER_MODE_LRU) ? 1 : 2;
+    for (uint32_t i = 0; i < num; i++) {
+        cm_mrc_sim_t* sim = &mrc->sim_array[i];
+        uint32_t shift = sample_shift;
+
+        while (shift > 0 && (cache_num_array[i] >> shift) < CM_MRC_SIM_NUM_MIN) {
+            shift--;
+        }
+
+        uint32_t sim_cache_num = cache_num_array[i] >> shift;
+
+        sim->cache_num = cache_num_array[i];
+        sim->sample_shift = shift;
+        sim->threshold = (1u << CM_MRC_HASH_BITS) >> shift;
+
+        for (uint32_t m = 0; m < mrc->sim_mode_num; m++) {
+            cache_manager_mode_t mode = (m == 0) ? cm->mode : CACHE_MANAGER_MODE_LRU;
+            sim->sim_array[m] = cm_create(sim_cache_num > 0 ? sim_cache_num : 1, mode, cm_mrc_create_cb, NULL, NULL, NULL);
+
+            if (!sim->sim_array[m]) {
+                goto failed;
+            }
+        }
+    }
+
+    return true;
+
+failed:
+    cm_mrc_disable(cm);
+    return false;
+}
+
+void cm_mrc_disable(cache_manager_t* cm)
+{
+    cache_manager_mrc_t* mrc = cm->mrc;
+
+    if (!mrc) {
+        return;
+    }
+
+    if (mrc->sim_array) {
+        for (uint32_t i = 0; i < mrc->sim_num; i++) {
+            for (uint32_t m = 0; m < 2; m++) {
+                if (mrc->sim_array[i].sim_array[m]) {
+                    cm_delete(mrc->sim_array[i].sim_array[m]);
+                }
+            }
+        }
+        CACHE_MANAGER_FREE(mrc->sim_array);
+    }
+
+    CACHE_MANAGER_FREE(mrc);
+    cm->mrc = NULL;
+}
+
+void cm_mrc_access(cache_manager_t* cm, int id)
+{
+    cache_manager_mrc_t* mrc = cm->mrc;
+
+    uint32_t hash = cm_mrc_hash(id);
+
+    mrc->access_cnt++;
+
+    for (uint32_t i = 0; i < mrc->sim_num; i++) {
+        cm_mrc_sim_t* sim = &mrc->sim_array[i];
+
+        if (hash >= sim->threshold) {
+            continue;
+        }
+
+        for (uint32_t m = 0; m < mrc->sim_mode_num; m++) {
+            cache_manager_node_t* node;
+            cm_open(sim->sim_array[m], id, &node);
+        }
+    }
+}
+
+void cm_mrc_set_mode(cache_manager_t* cm)
+{
+    /*The miniature caches follow the mode of cm and keep their ids, the
+     *counts taken with the old mode restart*/
+    cache_manager_mrc_t* mrc = cm->mrc;
+    uint32_t sim_mode_num = (cm->mode == CACHE_MANAGER_MODE_LRU) ? 1 : 2;
+
+    for (uint32_t i = 0; i < mrc->sim_num; i++) {
+        cm_mrc_sim_t* sim = &mrc->sim_array[i];
+
+        if (sim_mode_num < mrc->sim_mode_num) {
+            /*The LRU one now stands for both*/
+            cm_delete(sim->sim_array[0]);
+            sim->sim_array[0] = sim->sim_array[1];
+            sim->sim_array[1] = NULL;
+        } else if (sim_mode_num > mrc->sim_mode_num) {
+            sim->sim_array[1] = sim->sim_array[0];
+            sim->sim_array[0] = cm_create(sim->sim_array[1]->cache_num, cm->mode, cm_mrc_create_cb, NULL, NULL, NULL);
+
+            if (!sim->sim_array[0]) {
+                goto failed;
+            }
+        } else if (cm_set_mode(sim->sim_array[0], cm->mode) != CACHE_MANAGER_RES_OK) {
+            goto failed;
+        }
+    }
+
+    mrc->sim_mode_num = sim_mode_num;
+    cm_mrc_reset(cm);
+    return;
+
+failed:
+    CM_LOG_WARN("mrc can't follow mode %d, disabled", cm->mode);
+    cm_mrc_disable(cm);
+}
+
+static int cm_mrc_get_hit_rate(cache_manager_mrc_t* mrc, uint32_t sample_shift, cache_manager_t* sim)
+{
+    /*SHARDS_adj: a few popular ids falling in or out of the sample skew the
+     *count of sampled references, the difference with the expected count is
+     *mostly made of hits to those ids, so it is credited to the hits*/
+    int64_t expected = (int64_t)(mrc->access_cnt >> sample_shift);
+    int64_t hit_cnt = (int64_t)sim->stats.hit_cnt + expected - (int64_t)sim->stats.open_cnt;
+
+    if (expected <= 0) {
+        return cm_get_cache_hit_rate(sim);
+    }
+
+    if (hit_cnt < 0) {
+        hit_cnt = 0;
+    } else if (hit_cnt > expected) {
+        hit_cnt = expected;
+    }
+
+    return (int)(hit_cnt * 1000 / expected);
+}
+
+uint32_t cm_mrc_get(cache_manager_t* cm, cache_manager_mrc_point_t* point_array, uint32_t num)
+{
+    cache_manager_mrc_t* mrc = cm->mrc;
+
+    if (!mrc) {
+        return 0;
+    }
+
+    if (num > mrc->sim_num) {
+        num = mrc->sim_num;
+    }
+
+    for (uint32_t i = 0; i < num; i++) {
+        cm_mrc_sim_t* sim = &mrc->sim_array[i];
+        point_array[i].cache_num = sim->cache_num;
+        point_array[i].hit_rate = cm_mrc_get_hit_rate(mrc, sim->sample_shift, sim->sim_array[0]);
+        point_array[i].lru_hit_rate = cm_mrc_get_hit_rate(mrc, sim->sample_shift, sim->sim_array[mrc->sim_mode_num - 1]);
+    }
+
+    return num;
+}
+
+void cm_mrc_reset(cache_manager_t* cm)
+{
+    cache_manager_mrc_t* mrc = cm->mrc;
+
+    if (!mrc) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < mrc->sim_num; i++) {
+        for (uint32_t m = 0; m < mrc->sim_mode_num; m++) {
+            cm_reset_cache_hit_cnt(mrc->sim_array[i].sim_array[m]);
+        }
+    }
+
+    mrc->access_cnt = 0;
+}
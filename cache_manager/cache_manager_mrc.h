@@ -0,0 +1,64 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CACHE_MANAGER_MRC_H__
+#define __CACHE_MANAGER_MRC_H__
+
+#include "cache_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cache_manager_mrc_s cache_manager_mrc_t;
+
+typedef struct cache_manager_mrc_point_s {
+    uint32_t cache_num;
+    int hit_rate; /* with the mode of the cache, in permille */
+    int lru_hit_rate; /* with LRU, in permille */
+} cache_manager_mrc_point_t;
+
+/* Miss ratio curve estimation (SHARDS): the ids passed to cm_open() are
+ * sampled by hash at a rate of 1 / 2^sample_shift and replayed into one
+ * miniature cache per hypothetical capacity, scaled down by the same rate,
+ * for the mode of cm and for LRU. Capacities too small to be scaled down
+ * that much keep at least 64 nodes, sampled at a higher rate. The memory
+ * used is about sum(cache_num_array) >> sample_shift nodes per mode.
+ * cm_set_mode() switches the miniature caches along and restarts the counts,
+ * if that fails the estimator is disabled. */
+bool cm_mrc_enable(cache_manager_t* cm, const uint32_t* cache_num_array, uint32_t num, uint32_t sample_shift);
+void cm_mrc_disable(cache_manager_t* cm);
+/* Fills up to num points, one per capacity, returns how many were filled */
+uint32_t cm_mrc_get(cache_manager_t* cm, cache_manager_mrc_point_t* point_array, uint32_t num);
+void cm_mrc_reset(cache_manager_t* cm);
+
+/* Called by cm_open() for every valid id when the estimator is enabled */
+void cm_mrc_access(cache_manager_t* cm, int id);
+/* Called by cm_set_mode() after the mode of cm changed */
+void cm_mrc_set_mode(cache_manager_t* cm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CACHE_MANAGER_MRC_H__ */
@@ -0,0 +1,205 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cache_manager_pool.h"
+#include "cache_manager_config.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define CM_POOL_MIN_SHIFT 4
+#define CM_POOL_CLASS_MAX 28
+#define CM_POOL_CLASS_LARGE UINT32_MAX
+
+/*Every block starts with its size class, padded to keep the payload aligned*/
+typedef union {
+    struct {
+        uint32_t class_index;
+        uint32_t size;
+    } info;
+    uint64_t align_u64;
+    double align_double;
+    void* align_ptr;
+} cm_pool_header_t;
+
+typedef struct cm_pool_block_s {
+    struct cm_pool_block_s* next;
+} cm_pool_block_t;
+
+typedef struct cm_pool_slab_s {
+    struct cm_pool_slab_s* next;
+} cm_pool_slab_t;
+
+struct cache_manager_pool_s {
+    cm_pool_block_t* free_list[CM_POOL_CLASS_MAX];
+    cm_pool_slab_t* slab_list;
+    uint32_t class_num;
+    uint32_t slab_size;
+};
+
+static uint32_t cm_pool_get_class_size(uint32_t class_index)
+{
+    return (uint32_t)1 << (class_index + CM_POOL_MIN_SHIFT);
+}
+
+static uint32_t cm_pool_get_class(cache_manager_pool_t* pool, uint32_t size)
+{
+    uint32_t class_index = 0;
+
+    while (class_index < pool->class_num && cm_pool_get_class_size(class_index) < size) {
+        class_index++;
+    }
+
+    return class_index < pool->class_num ? class_index : CM_POOL_CLASS_LARGE;
+}
+
+static cm_pool_header_t* cm_pool_get_header(void* ptr)
+{
+    return (cm_pool_header_t*)ptr - 1;
+}
+
+static bool cm_pool_grow(cache_manager_pool_t* pool, uint32_t class_index)
+{
+    /*In size_t, a few blocks of the largest classes don't fit in 32 bits*/
+    size_t block_size = sizeof(cm_pool_header_t) + (size_t)cm_pool_get_class_size(class_index);
+    size_t block_num = 0;
+
+    if (pool->slab_size > sizeof(cm_pool_header_t)) {
+        block_num = (pool->slab_size - sizeof(cm_pool_header_t)) / block_size;
+    }
+
+    if (block_num == 0) {
+        block_num = 1;
+    }
+
+    /*The slab link takes a header-sized cell so that blocks stay aligned*/
+    uint8_t* slab = CACHE_MANAGER_MALLOC(sizeof(cm_pool_header_t) + block_size * block_num);
+
+    if (!slab) {
+        CM_LOG_ERROR("slab malloc failed");
+        return false;
+    }
+
+    ((cm_pool_slab_t*)slab)->next = pool->slab_list;
+    pool->slab_list = (cm_pool_slab_t*)slab;
+
+    uint8_t* block = slab + sizeof(cm_pool_header_t);
+
+    for (size_t i = 0; i < block_num; i++) {
+        cm_pool_header_t* header = (cm_pool_header_t*)block;
+        header->info.class_index = class_index;
+        header->info.size = cm_pool_get_class_size(class_index);
+
+        cm_pool_block_t* free_block = (cm_pool_block_t*)(header + 1);
+        free_block->next = pool->free_list[class_index];
+        pool->free_list[class_index] = free_block;
+
+        block += block_size;
+    }
+
+    return true;
+}
+
+cache_manager_pool_t* cm_pool_create(uint32_t max_block_size, uint32_t slab_size)
+{
+    cache_manager_pool_t* pool = CACHE_MANAGER_MALLOC(sizeof(cache_manager_pool_t));
+
+    if (!pool) {
+        CM_LOG_ERROR("pool malloc failed");
+        return NULL;
+    }
+
+    memset(pool, 0, sizeof(cache_manager_pool_t));
+
+    while (pool->class_num < CM_POOL_CLASS_MAX && cm_pool_get_class_size(pool->class_num) < max_block_size) {
+        pool->class_num++;
+    }
+
+    if (pool->class_num < CM_POOL_CLASS_MAX) {
+        pool->class_num++;
+    }
+
+    pool->slab_size = slab_size;
+
+    return pool;
+}
+
+void cm_pool_delete(cache_manager_pool_t* pool)
+{
+    cm_pool_slab_t* slab = pool->slab_list;
+
+    while (slab) {
+        cm_pool_slab_t* next = slab->next;
+        CACHE_MANAGER_FREE(slab);
+        slab = next;
+    }
+
+    CACHE_MANAGER_FREE(pool);
+}
+
+void* cm_pool_malloc(cache_manager_pool_t* pool, uint32_t size)
+{
+    uint32_t class_index = cm_pool_get_class(pool, size);
+
+    if (class_index == CM_POOL_CLASS_LARGE) {
+        cm_pool_header_t* header = CACHE_MANAGER_MALLOC(sizeof(cm_pool_header_t) + size);
+
+        if (!header) {
+            return NULL;
+        }
+
+        header->info.class_index = CM_POOL_CLASS_LARGE;
+        header->info.size = size;
+        return header + 1;
+    }
+
+    if (!pool->free_list[class_index] && !cm_pool_grow(pool, class_index)) {
+        return NULL;
+    }
+
+    cm_pool_block_t* block = pool->free_list[class_index];
+    pool->free_list[class_index] = block->next;
+    return block;
+}
+
+void cm_pool_free(cache_manager_pool_t* pool, void* ptr)
+{
+    if (!ptr) {
+        return;
+    }
+
+    cm_pool_header_t* header = cm_pool_get_header(ptr);
+
+    if (header->info.class_index == CM_POOL_CLASS_LARGE) {
+        CACHE_MANAGER_FREE(header);
+        return;
+    }
+
+    cm_pool_block_t* block = ptr;
+    block->next = pool->free_list[header->info.class_index];
+    pool->free_list[header->info.class_index] = block;
+}
+
+uint32_t cm_pool_get_block_size(cache_manager_pool_t* pool, void* ptr)
+{
+    return ptr ? cm_pool_get_header(ptr)->info.size : 0;
+}
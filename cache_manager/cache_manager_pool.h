@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CACHE_MANAGER_POOL_H__
+#define __CACHE_MANAGER_POOL_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct cache_manager_pool_s;
+
+/* Slab allocator for node payloads, to be used from create_cb/delete_cb.
+ * Blocks are served from power-of-two size classes up to max_block_size,
+ * carved out of slabs of slab_size bytes obtained with CACHE_MANAGER_MALLOC.
+ * Freed blocks go back to their class and are never returned to the heap
+ * before cm_pool_delete(), so steady churn doesn't fragment it. Larger
+ * requests fall through to CACHE_MANAGER_MALLOC. Not thread-safe, like
+ * cache_manager_t: use one pool per cache or per shard. */
+typedef struct cache_manager_pool_s cache_manager_pool_t;
+
+cache_manager_pool_t* cm_pool_create(uint32_t max_block_size, uint32_t slab_size);
+void cm_pool_delete(cache_manager_pool_t* pool);
+void* cm_pool_malloc(cache_manager_pool_t* pool, uint32_t size);
+void cm_pool_free(cache_manager_pool_t* pool, void* ptr);
+/* Usable size of a block, e.g. to check whether a recycled buffer fits */
+uint32_t cm_pool_get_block_size(cache_manager_pool_t* pool, void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CACHE_MANAGER_POOL_H__ */
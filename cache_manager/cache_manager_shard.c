@@ -0,0 +1,755 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cache_manager_shard.h"
+#include "cache_manager_config.h"
+#include "cache_manager_trace.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+
+/*A miss whose create_cb is running, later misses on the same id wait for it*/
+typedef struct cm_shard_flight_s {
+    struct cm_shard_flight_s* next;
+    int id;
+    uint32_t waiter_cnt;
+    bool done;
+    cache_manager_res_t res;
+} cm_shard_flight_t;
+
+#define CM_SHARD_READ_BUFFER_MASK (CACHE_MANAGER_READ_BUFFER_SIZE - 1)
+
+/*A hit taken without the lock, waiting to be replayed into the policy*/
+typedef struct {
+    int id; /* 0 until published */
+    uint32_t slot;
+} cm_shard_read_t;
+
+/*Lossy ring of hits: any thread may add, only the lock holder drains*/
+typedef struct {
+    uint32_t write; /* entries ever claimed */
+    uint32_t read; /* entries ever drained */
+    uint32_t drop_cnt; /* hits that found the ring full */
+    cm_shard_read_t entry_array[CACHE_MANAGER_READ_BUFFER_SIZE];
+} cm_shard_read_buffer_t;
+
+typedef union {
+    cm_shard_read_buffer_t buffer;
+    uint8_t pad[(sizeof(cm_shard_read_buffer_t) + CACHE_MANAGER_CACHE_LINE_SIZE - 1)
+        / CACHE_MANAGER_CACHE_LINE_SIZE * CACHE_MANAGER_CACHE_LINE_SIZE];
+} cm_shard_read_buffer_padded_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t flight_cond;
+    cm_shard_flight_t* flight_list;
+    cache_manager_t* cm;
+    uint32_t seq; /* odd while the lock holder may modify cm */
+    cm_shard_read_buffer_padded_t* read_buffer_array; /* NULL without lock-free hits */
+} cm_shard_slot_t;
+
+/*Pad every shard to its own cache lines so that locks don't false-share*/
+typedef union {
+    cm_shard_slot_t slot;
+    uint8_t pad[(sizeof(cm_shard_slot_t) + CACHE_MANAGER_CACHE_LINE_SIZE - 1)
+        / CACHE_MANAGER_CACHE_LINE_SIZE * CACHE_MANAGER_CACHE_LINE_SIZE];
+} cm_shard_slot_padded_t;
+
+/*A background load queued by cm_shard_open_async() or cm_shard_prefetch()*/
+typedef struct cm_shard_job_s {
+    struct cm_shard_job_s* next;
+    int id;
+    cache_manager_async_cb_t async_cb;
+    void* user_data;
+} cm_shard_job_t;
+
+typedef struct {
+    pthread_t* thread_array;
+    uint32_t thread_num;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    cm_shard_job_t* job_head;
+    cm_shard_job_t* job_tail;
+    bool stop;
+} cm_shard_pool_t;
+
+struct cache_manager_shard_s {
+    cm_shard_slot_padded_t* slot_array;
+    uint32_t shard_num;
+    cm_shard_pool_t pool;
+    bool lock_free_hit;
+};
+
+static cm_shard_slot_t* cm_shard_get_slot(cache_manager_shard_t* shard, int id)
+{
+    /*Fibonacci hashing, independent from the low bits used by the per-shard index*/
+    uint32_t h = (uint32_t)id * 0x9E3779B1;
+    uint32_t index = (uint32_t)(((uint64_t)h * shard->shard_num) >> 32);
+    return &(shard->slot_array[index].slot);
+}
+
+static void cm_shard_write_begin(cm_shard_slot_t* slot)
+{
+    CM_ATOMIC_STORE(&slot->seq, slot->seq + 1);
+    CM_ATOMIC_FENCE_RELEASE();
+}
+
+static void cm_shard_write_end(cm_shard_slot_t* slot)
+{
+    CM_ATOMIC_STORE_RELEASE(&slot->seq, slot->seq + 1);
+}
+
+static void cm_shard_drain(cm_shard_slot_t* slot)
+{
+    if (!slot->read_buffer_array) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < CACHE_MANAGER_READ_BUFFER_NUM; i++) {
+        cm_shard_read_buffer_t* buffer = &(slot->read_buffer_array[i].buffer);
+        uint32_t read = buffer->read;
+        uint32_t write = CM_ATOMIC_LOAD_ACQUIRE(&buffer->write);
+
+        while (read != write) {
+            cm_shard_read_t* entry = &(buffer->entry_array[read & CM_SHARD_READ_BUFFER_MASK]);
+            int id = CM_ATOMIC_LOAD_ACQUIRE(&entry->id);
+
+            /*Claimed but not published yet, it goes with the next drain*/
+            if (id == CACHE_MANAGER_INVALIDATE_ID) {
+                break;
+            }
+
+            uint32_t node_slot = CM_ATOMIC_LOAD(&entry->slot);
+            CM_ATOMIC_STORE(&entry->id, CACHE_MANAGER_INVALIDATE_ID);
+            cm_replay_hit(slot->cm, id, node_slot);
+            read++;
+        }
+
+        CM_ATOMIC_STORE_RELEASE(&buffer->read, read);
+
+        /*Dropped hits still count, they only miss their policy update*/
+        uint32_t drop_cnt = CM_ATOMIC_LOAD(&buffer->drop_cnt);
+
+        if (drop_cnt > 0) {
+            CM_ATOMIC_FETCH_ADD(&buffer->drop_cnt, (uint32_t)-drop_cnt);
+            slot->cm->stats.open_cnt += drop_cnt;
+            slot->cm->stats.hit_cnt += drop_cnt;
+        }
+    }
+}
+
+/*Every section under the lock is a write for the lock-free readers*/
+static void cm_shard_lock(cm_shard_slot_t* slot)
+{
+    pthread_mutex_lock(&slot->lock);
+    cm_shard_write_begin(slot);
+    cm_shard_drain(slot);
+}
+
+static void cm_shard_unlock(cm_shard_slot_t* slot)
+{
+    cm_shard_write_end(slot);
+    pthread_mutex_unlock(&slot->lock);
+}
+
+static uint32_t cm_shard_get_thread_index(void)
+{
+    /*Threads take the read buffers in turn on their first hit*/
+    static uint32_t thread_cnt;
+    static CM_THREAD_LOCAL uint32_t thread_index;
+
+    if (thread_index == 0) {
+        thread_index = CM_ATOMIC_FETCH_ADD(&thread_cnt, 1) + 1;
+    }
+
+    return thread_index;
+}
+
+static void cm_shard_record_read(cm_shard_slot_t* slot, int id, uint32_t node_slot)
+{
+    uint32_t index = cm_shard_get_thread_index() % CACHE_MANAGER_READ_BUFFER_NUM;
+    cm_shard_read_buffer_t* buffer = &(slot->read_buffer_array[index].buffer);
+    uint32_t write = CM_ATOMIC_LOAD(&buffer->write);
+    uint32_t pending;
+
+    do {
+        pending = write - CM_ATOMIC_LOAD_ACQUIRE(&buffer->read);
+
+        if (pending >= CACHE_MANAGER_READ_BUFFER_SIZE) {
+            CM_ATOMIC_FETCH_ADD(&buffer->drop_cnt, 1);
+            break;
+        }
+    } while (!CM_ATOMIC_CAS(&buffer->write, &write, write + 1));
+
+    if (pending < CACHE_MANAGER_READ_BUFFER_SIZE) {
+        cm_shard_read_t* entry = &(buffer->entry_array[write & CM_SHARD_READ_BUFFER_MASK]);
+        CM_ATOMIC_STORE(&entry->slot, node_slot);
+        CM_ATOMIC_STORE_RELEASE(&entry->id, id);
+        pending++;
+    }
+
+    /*Half full: replay if the lock is free, never wait for it on a hit*/
+    if (pending >= CACHE_MANAGER_READ_BUFFER_SIZE / 2 && pthread_mutex_trylock(&slot->lock) == 0) {
+        cm_shard_write_begin(slot);
+        cm_shard_drain(slot);
+        cm_shard_unlock(slot);
+    }
+}
+
+static bool cm_shard_read(cm_shard_slot_t* slot, int id, cache_manager_node_t** node_p)
+{
+    uint32_t seq = CM_ATOMIC_LOAD_ACQUIRE(&slot->seq);
+
+    if (seq & 1) {
+        return false;
+    }
+
+    cache_manager_node_t* node = cm_find_optimistic(slot->cm, id);
+
+    /*Any write since the first read of seq may have torn the lookup*/
+    CM_ATOMIC_FENCE_ACQUIRE();
+    if (!node || CM_ATOMIC_LOAD(&slot->seq) != seq) {
+        return false;
+    }
+
+    cm_shard_record_read(slot, id, (uint32_t)(node - slot->cm->cache_node_array));
+    *node_p = node;
+    return true;
+}
+
+static cm_shard_flight_t* cm_shard_find_flight(cm_shard_slot_t* slot, int id)
+{
+    /*Only as many flights as concurrent misses, a list is enough*/
+    for (cm_shard_flight_t* flight = slot->flight_list; flight; flight = flight->next) {
+        if (flight->id == id) {
+            return flight;
+        }
+    }
+    return NULL;
+}
+
+static void cm_shard_remove_flight(cm_shard_slot_t* slot, cm_shard_flight_t* flight)
+{
+    cm_shard_flight_t** cur = &slot->flight_list;
+    while (*cur != flight) {
+        cur = &(*cur)->next;
+    }
+    *cur = flight->next;
+}
+
+static cache_manager_res_t cm_shard_load(cm_shard_slot_t* slot, int id, cache_manager_node_t** node_p, bool wait)
+{
+    cache_manager_res_t res;
+
+    while (true) {
+        cm_shard_flight_t* flight = cm_shard_find_flight(slot, id);
+
+        if (!flight) {
+            break;
+        }
+
+        if (!wait) {
+            return CACHE_MANAGER_RES_PENDING;
+        }
+
+        flight->waiter_cnt++;
+        cm_shard_write_end(slot);
+        while (!flight->done) {
+            pthread_cond_wait(&slot->flight_cond, &slot->lock);
+        }
+        cm_shard_write_begin(slot);
+        flight->waiter_cnt--;
+
+        res = flight->res;
+
+        if (flight->waiter_cnt == 0) {
+            CACHE_MANAGER_FREE(flight);
+        }
+
+        if (res != CACHE_MANAGER_RES_OK) {
+            return res;
+        }
+
+        cache_manager_node_t* node = cm_peek(slot->cm, id);
+
+        if (node) {
+            *node_p = node;
+            return CACHE_MANAGER_RES_OK;
+        }
+
+        /*Evicted again before this waiter woke up, load it ourselves*/
+    }
+
+    cm_shard_flight_t* flight = CACHE_MANAGER_MALLOC(sizeof(cm_shard_flight_t));
+
+    if (!flight) {
+        CM_LOG_ERROR("flight malloc failed");
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    memset(flight, 0, sizeof(cm_shard_flight_t));
+    flight->id = id;
+    flight->next = slot->flight_list;
+    slot->flight_list = flight;
+
+    /*Run create_cb without holding the shard, hits on it go on meanwhile*/
+    cm_shard_unlock(slot);
+    cache_manager_node_t node_tmp;
+    res = cm_load(slot->cm, id, &node_tmp);
+    cm_shard_lock(slot);
+
+    if (res == CACHE_MANAGER_RES_OK) {
+        res = cm_insert(slot->cm, &node_tmp, node_p);
+    } else if (res == CACHE_MANAGER_RES_ERR_CREATE_FAILED) {
+        cm_load_failed(slot->cm, id);
+    }
+
+    cm_shard_remove_flight(slot, flight);
+    flight->res = res;
+    flight->done = true;
+
+    if (flight->waiter_cnt > 0) {
+        pthread_cond_broadcast(&slot->flight_cond);
+    } else {
+        CACHE_MANAGER_FREE(flight);
+    }
+
+    return res;
+}
+
+static cache_manager_res_t cm_shard_open_ex(cache_manager_shard_t* shard, int id, cache_manager_node_t** node_p, bool wait, bool pin)
+{
+    cm_shard_slot_t* slot = cm_shard_get_slot(shard, id);
+
+    if (shard->lock_free_hit && !pin && cm_shard_read(slot, id, node_p)) {
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    cm_shard_lock(slot);
+
+    cache_manager_res_t res = cm_lookup(slot->cm, id, node_p);
+
+    if (res == CACHE_MANAGER_RES_ERR_ID_NOT_FOUND) {
+        res = cm_shard_load(slot, id, node_p, wait);
+    }
+
+    if (res == CACHE_MANAGER_RES_OK && pin) {
+        cm_pin(slot->cm, *node_p);
+    }
+
+    cm_shard_unlock(slot);
+
+    return res;
+}
+
+static void cm_shard_run_job(cache_manager_shard_t* shard, cm_shard_job_t* job)
+{
+    cm_shard_slot_t* slot = cm_shard_get_slot(shard, job->id);
+    cache_manager_node_t* node = NULL;
+    cache_manager_res_t res = CACHE_MANAGER_RES_OK;
+
+    cm_shard_lock(slot);
+
+    node = cm_peek(slot->cm, job->id);
+
+    if (!node) {
+        res = cm_shard_load(slot, job->id, &node, true);
+    }
+
+    if (job->async_cb) {
+        job->async_cb(res, job->id, res == CACHE_MANAGER_RES_OK ? node : NULL, job->user_data);
+    }
+
+    cm_shard_unlock(slot);
+}
+
+static void* cm_shard_worker(void* arg)
+{
+    cache_manager_shard_t* shard = arg;
+    cm_shard_pool_t* pool = &shard->pool;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true) {
+        while (!pool->job_head && !pool->stop) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+
+        /*Drain the queue before stopping, every async_cb gets its call*/
+        cm_shard_job_t* job = pool->job_head;
+
+        if (!job) {
+            break;
+        }
+
+        pool->job_head = job->next;
+        if (!pool->job_head) {
+            pool->job_tail = NULL;
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+        cm_shard_run_job(shard, job);
+        CACHE_MANAGER_FREE(job);
+        pthread_mutex_lock(&pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void cm_shard_stop_workers(cache_manager_shard_t* shard)
+{
+    cm_shard_pool_t* pool = &shard->pool;
+
+    if (pool->thread_num == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0; i < pool->thread_num; i++) {
+        pthread_join(pool->thread_array[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    CACHE_MANAGER_FREE(pool->thread_array);
+    memset(pool, 0, sizeof(cm_shard_pool_t));
+}
+
+static cache_manager_res_t cm_shard_submit(cache_manager_shard_t* shard, int id, cache_manager_async_cb_t async_cb, void* user_data)
+{
+    cm_shard_pool_t* pool = &shard->pool;
+
+    if (pool->thread_num == 0) {
+        /*No workers, load in the caller*/
+        cm_shard_job_t job = { NULL, id, async_cb, user_data };
+        cm_shard_run_job(shard, &job);
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    cm_shard_job_t* job = CACHE_MANAGER_MALLOC(sizeof(cm_shard_job_t));
+
+    if (!job) {
+        CM_LOG_ERROR("job malloc failed");
+        return CACHE_MANAGER_RES_ERR_UNKNOW;
+    }
+
+    job->next = NULL;
+    job->id = id;
+    job->async_cb = async_cb;
+    job->user_data = user_data;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->job_tail) {
+        pool->job_tail->next = job;
+    } else {
+        pool->job_head = job;
+    }
+    pool->job_tail = job;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return CACHE_MANAGER_RES_PENDING;
+}
+
+cache_manager_shard_t* cm_shard_create(
+    uint32_t shard_num,
+    uint32_t cache_num,
+    cache_manager_mode_t mode,
+    cache_manager_user_cb_t create_cb,
+    cache_manager_user_cb_t delete_cb,
+    cache_manager_tick_get_cb_t tick_get_cb,
+    void* user_data)
+{
+    if (shard_num == 0) {
+        CM_LOG_ERROR("shard_num must not be 0");
+        return NULL;
+    }
+
+    cache_manager_shard_t* shard = CACHE_MANAGER_MALLOC(sizeof(cache_manager_shard_t));
+
+    if (!shard) {
+        CM_LOG_ERROR("cache_manager_shard malloc failed");
+        return NULL;
+    }
+
+    shard->slot_array = CACHE_MANAGER_MALLOC(sizeof(cm_shard_slot_padded_t) * shard_num);
+
+    if (!shard->slot_array) {
+        CM_LOG_ERROR("slot_array malloc failed");
+        CACHE_MANAGER_FREE(shard);
+        return NULL;
+    }
+
+    memset(shard->slot_array, 0, sizeof(cm_shard_slot_padded_t) * shard_num);
+    shard->shard_num = 0;
+    memset(&shard->pool, 0, sizeof(cm_shard_pool_t));
+
+    /*Every shard gets an equal part of the capacity, rounded up*/
+    uint32_t shard_cache_num = (cache_num + shard_num - 1) / shard_num;
+
+    for (uint32_t i = 0; i < shard_num; i++) {
+        cm_shard_slot_t* slot = &(shard->slot_array[i].slot);
+
+        slot->cm = cm_create(shard_cache_num, mode, create_cb, delete_cb, tick_get_cb, user_data);
+
+        if (!slot->cm) {
+            cm_shard_delete(shard);
+            return NULL;
+        }
+
+        pthread_mutex_init(&slot->lock, NULL);
+        pthread_cond_init(&slot->flight_cond, NULL);
+        shard->shard_num++;
+    }
+
+    CM_LOG_INFO("cache_manager_shard create OK, shard num = %" PRIu32 ", cache num = %" PRIu32,
+        shard_num, shard_cache_num);
+
+    return shard;
+}
+
+void cm_shard_delete(cache_manager_shard_t* shard)
+{
+    cm_shard_stop_workers(shard);
+
+    for (uint32_t i = 0; i < shard->shard_num; i++) {
+        cm_shard_slot_t* slot = &(shard->slot_array[i].slot);
+        cm_delete(slot->cm);
+        if (slot->read_buffer_array) {
+            CACHE_MANAGER_FREE(slot->read_buffer_array);
+        }
+        pthread_mutex_destroy(&slot->lock);
+        pthread_cond_destroy(&slot->flight_cond);
+    }
+
+    CACHE_MANAGER_FREE(shard->slot_array);
+    CACHE_MANAGER_FREE(shard);
+}
+
+cache_manager_res_t cm_shard_open(cache_manager_shard_t* shard, int id, cache_manager_node_t** node_p)
+{
+    return cm_shard_open_ex(shard, id, node_p, true, false);
+}
+
+cache_manager_res_t cm_shard_try_open(cache_manager_shard_t* shard, int id, cache_manager_node_t** node_p)
+{
+    return cm_shard_open_ex(shard, id, node_p, false, false);
+}
+
+cache_manager_res_t cm_shard_acquire(cache_manager_shard_t* shard, int id, cache_manager_node_t** node_p)
+{
+    return cm_shard_open_ex(shard, id, node_p, true, true);
+}
+
+void cm_shard_release(cache_manager_shard_t* shard, cache_manager_node_t* node)
+{
+    cm_shard_slot_t* slot = cm_shard_get_slot(shard, node->id);
+
+    cm_shard_lock(slot);
+    cm_release(slot->cm, node);
+    cm_shard_unlock(slot);
+}
+
+bool cm_shard_set_lock_free_hit(cache_manager_shard_t* shard, bool enable)
+{
+    for (uint32_t i = 0; i < shard->shard_num; i++) {
+        cm_shard_slot_t* slot = &(shard->slot_array[i].slot);
+
+        cm_shard_lock(slot);
+
+        if (enable && !slot->read_buffer_array) {
+            size_t size = sizeof(cm_shard_read_buffer_padded_t) * CACHE_MANAGER_READ_BUFFER_NUM;
+            slot->read_buffer_array = CACHE_MANAGER_MALLOC(size);
+
+            if (!slot->read_buffer_array) {
+                CM_LOG_ERROR("read_buffer_array malloc failed");
+                cm_shard_unlock(slot);
+                cm_shard_set_lock_free_hit(shard, false);
+                return false;
+            }
+
+            memset(slot->read_buffer_array, 0, size);
+        } else if (!enable && slot->read_buffer_array) {
+            /*The lock already replayed what the buffers held*/
+            CACHE_MANAGER_FREE(slot->read_buffer_array);
+            slot->read_buffer_array = NULL;
+        }
+
+        slot->cm->lock_free_hit = enable;
+        cm_shard_unlock(slot);
+    }
+
+    shard->lock_free_hit = enable;
+    return true;
+}
+
+bool cm_shard_start_workers(cache_manager_shard_t* shard, uint32_t worker_num)
+{
+    cm_shard_pool_t* pool = &shard->pool;
+
+    if (pool->thread_num > 0 || worker_num == 0) {
+        CM_LOG_WARN("workers already started or worker_num is 0");
+        return false;
+    }
+
+    pool->thread_array = CACHE_MANAGER_MALLOC(sizeof(pthread_t) * worker_num);
+
+    if (!pool->thread_array) {
+        CM_LOG_ERROR("thread_array malloc failed");
+        return false;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (uint32_t i = 0; i < worker_num; i++) {
+        if (pthread_create(&pool->thread_array[i], NULL, cm_shard_worker, shard) != 0) {
+            CM_LOG_ERROR("worker %" PRIu32 " create failed", i);
+            break;
+        }
+        pool->thread_num++;
+    }
+
+    if (pool->thread_num == 0) {
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->cond);
+        CACHE_MANAGER_FREE(pool->thread_array);
+        memset(pool, 0, sizeof(cm_shard_pool_t));
+        return false;
+    }
+
+    return true;
+}
+
+cache_manager_res_t cm_shard_open_async(cache_manager_shard_t* shard, int id, cache_manager_async_cb_t async_cb, void* user_data)
+{
+    cm_shard_slot_t* slot = cm_shard_get_slot(shard, id);
+    cache_manager_node_t* node;
+
+    cm_shard_lock(slot);
+
+    cache_manager_res_t res = cm_lookup(slot->cm, id, &node);
+
+    if (res == CACHE_MANAGER_RES_OK) {
+        /*Hits complete right away in the caller*/
+        async_cb(res, id, node, user_data);
+    }
+
+    cm_shard_unlock(slot);
+
+    if (res != CACHE_MANAGER_RES_ERR_ID_NOT_FOUND) {
+        return res;
+    }
+
+    return cm_shard_submit(shard, id, async_cb, user_data);
+}
+
+cache_manager_res_t cm_shard_prefetch(cache_manager_shard_t* shard, int id)
+{
+    cm_shard_slot_t* slot = cm_shard_get_slot(shard, id);
+
+    if (id == CACHE_MANAGER_INVALIDATE_ID) {
+        return CACHE_MANAGER_RES_ERR_ID_INVALIDATE;
+    }
+
+    cm_shard_lock(slot);
+    bool skip = cm_peek(slot->cm, id) || cm_shard_find_flight(slot, id);
+    cm_shard_unlock(slot);
+
+    if (skip) {
+        return CACHE_MANAGER_RES_OK;
+    }
+
+    return cm_shard_submit(shard, id, NULL, NULL);
+}
+
+cache_manager_res_t cm_shard_invalidate(cache_manager_shard_t* shard, int id)
+{
+    cm_shard_slot_t* slot = cm_shard_get_slot(shard, id);
+
+    cm_shard_lock(slot);
+    cache_manager_res_t res = cm_invalidate(slot->cm, id);
+    cm_shard_unlock(slot);
+
+    return res;
+}
+
+void cm_shard_clear(cache_manager_shard_t* shard)
+{
+    for (uint32_t i = 0; i < shard->shard_num; i++) {
+        cm_shard_slot_t* slot = &(shard->slot_array[i].slot);
+        cm_shard_lock(slot);
+        cm_clear(slot->cm);
+        cm_shard_unlock(slot);
+    }
+}
+
+int cm_shard_get_cache_hit_rate(cache_manager_shard_t* shard)
+{
+    cache_manager_stats_t stats;
+    cm_shard_get_stats(shard, &stats);
+
+    if (stats.open_cnt == 0) {
+        return 0;
+    }
+
+    return (int)(stats.hit_cnt * 1000 / stats.open_cnt);
+}
+
+void cm_shard_get_stats(cache_manager_shard_t* shard, cache_manager_stats_t* stats)
+{
+    memset(stats, 0, sizeof(cache_manager_stats_t));
+
+    for (uint32_t i = 0; i < shard->shard_num; i++) {
+        cm_shard_slot_t* slot = &(shard->slot_array[i].slot);
+        cm_shard_lock(slot);
+        cm_stats_merge(stats, &slot->cm->stats);
+        cm_shard_unlock(slot);
+    }
+}
+
+void cm_shard_set_trace(cache_manager_shard_t* shard, struct cache_manager_trace_s* trace)
+{
+    for (uint32_t i = 0; i < shard->shard_num; i++) {
+        cm_shard_slot_t* slot = &(shard->slot_array[i].slot);
+        cm_shard_lock(slot);
+        cm_set_trace(slot->cm, trace, (uint16_t)i);
+        cm_shard_unlock(slot);
+    }
+}
+
+void cm_shard_reset_cache_hit_cnt(cache_manager_shard_t* shard)
+{
+    for (uint32_t i = 0; i < shard->shard_num; i++) {
+        cm_shard_slot_t* slot = &(shard->slot_array[i].slot);
+        cm_shard_lock(slot);
+        cm_reset_cache_hit_cnt(slot->cm);
+        cm_shard_unlock(slot);
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CACHE_MANAGER_SHARD_H__
+#define __CACHE_MANAGER_SHARD_H__
+
+#include "cache_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct cache_manager_shard_s;
+
+/* Thread-safe cache manager: the id space is split across shard_num
+ * independent cache_manager_t, each protected by its own lock.
+ * The node returned by cm_shard_open() lives in the shard's array and,
+ * like with cm_open(), may be reused by a later miss on the same shard.
+ * cm_shard_acquire() pins it instead, so that the context can be used
+ * without a copy until cm_shard_release().
+ * create_cb runs outside of the shard lock and at most once per id at a
+ * time: concurrent misses on an id being created wait for that creation,
+ * cm_shard_try_open() returns CACHE_MANAGER_RES_PENDING instead. */
+typedef struct cache_manager_shard_s cache_manager_shard_t;
+
+/* Completion of cm_shard_open_async(). It's called with the shard locked,
+ * so node can be read safely but the callback must not call back into
+ * the same cache_manager_shard_t. node is NULL when res isn't OK. */
+typedef void (*cache_manager_async_cb_t)(cache_manager_res_t res, int id, cache_manager_node_t* node, void* user_data);
+
+cache_manager_shard_t* cm_shard_create(
+    uint32_t shard_num,
+    uint32_t cache_num,
+    cache_manager_mode_t mode,
+    cache_manager_user_cb_t create_cb,
+    cache_manager_user_cb_t delete_cb,
+    cache_manager_tick_get_cb_t tick_get_cb,
+    void* user_data);
+void cm_shard_delete(cache_manager_shard_t* shard);
+cache_manager_res_t cm_shard_open(cache_manager_shard_t* shard, int id, cache_manager_node_t** node_p);
+cache_manager_res_t cm_shard_try_open(cache_manager_shard_t* shard, int id, cache_manager_node_t** node_p);
+
+/* Loads run create_cb on worker_num background threads once started,
+ * otherwise in the caller. cm_shard_open_async() completes hits in place
+ * and returns CACHE_MANAGER_RES_PENDING for queued misses.
+ * cm_shard_prefetch() queues a load without counting an open. */
+bool cm_shard_start_workers(cache_manager_shard_t* shard, uint32_t worker_num);
+cache_manager_res_t cm_shard_open_async(cache_manager_shard_t* shard, int id, cache_manager_async_cb_t async_cb, void* user_data);
+cache_manager_res_t cm_shard_prefetch(cache_manager_shard_t* shard, int id);
+
+/* Lock-free hits for read-heavy workloads: cm_shard_open() and
+ * cm_shard_try_open() look the id up without the shard lock, validating
+ * the lookup against a sequence count that every locked section bumps,
+ * and queue the hit in a per-thread read buffer instead of touching the
+ * policy. The buffers are replayed in batches by the next lock holder or
+ * once half full, so stats and policy order lag by up to
+ * CACHE_MANAGER_READ_BUFFER_SIZE hits per thread; a hit that finds its
+ * buffer full is only counted. Misses, pins and entries with a deadline
+ * take the lock as before. Set it before the shard is shared between
+ * threads. The lookup relies on the shard never reallocating the index and
+ * node arrays of its caches, so while it is enabled their cm_set_cache_num(),
+ * cm_set_mode() and cm_set_key_mode() fail with CACHE_MANAGER_RES_ERR_MODE.
+ * Returns false if the buffers can't be allocated. */
+bool cm_shard_set_lock_free_hit(cache_manager_shard_t* shard, bool enable);
+
+cache_manager_res_t cm_shard_acquire(cache_manager_shard_t* shard, int id, cache_manager_node_t** node_p);
+void cm_shard_release(cache_manager_shard_t* shard, cache_manager_node_t* node);
+cache_manager_res_t cm_shard_invalidate(cache_manager_shard_t* shard, int id);
+void cm_shard_clear(cache_manager_shard_t* shard);
+
+int cm_shard_get_cache_hit_rate(cache_manager_shard_t* shard);
+void cm_shard_reset_cache_hit_cnt(cache_manager_shard_t* shard);
+/* Sum of the stats of every shard. Each shard counts into its own
+ * cache_manager_t, under its own lock and in its own cache line, so
+ * threads working on different shards never share a counter. */
+void cm_shard_get_stats(cache_manager_shard_t* shard, cache_manager_stats_t* stats);
+/* Every shard records into the same trace, with its index as the source
+ * of the events, see cache_manager_trace.h. NULL detaches. */
+void cm_shard_set_trace(cache_manager_shard_t* shard, struct cache_manager_trace_s* trace);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CACHE_MANAGER_SHARD_H__ */
@@ -0,0 +1,85 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cache_manager_simd.h"
+#include "cache_manager_config.h"
+
+#if CACHE_MANAGER_USE_SIMD && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+static uint32_t cm_simd_first_bit(uint32_t mask)
+{
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_ctz(mask);
+#else
+    uint32_t i = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+uint32_t cm_simd_find_id(const int* id_array, uint32_t num, int id)
+{
+    uint32_t i = 0;
+
+#if CACHE_MANAGER_USE_SIMD && defined(__AVX2__)
+    /*8 ids per compare, two vectors per iteration to hide the latency*/
+    __m256i key8 = _mm256_set1_epi32(id);
+
+    for (; i + 16 <= num; i += 16) {
+        __m256i eq0 = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(id_array + i)), key8);
+        __m256i eq1 = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(id_array + i + 8)), key8);
+        uint32_t mask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq0))
+            | ((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq1)) << 8);
+
+        if (mask) {
+            return i + cm_simd_first_bit(mask);
+        }
+    }
+#endif
+
+#if CACHE_MANAGER_USE_SIMD && defined(__SSE2__)
+    __m128i key4 = _mm_set1_epi32(id);
+
+    for (; i + 4 <= num; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(id_array + i)), key4);
+        uint32_t mask = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(eq));
+
+        if (mask) {
+            return i + cm_simd_first_bit(mask);
+        }
+    }
+#endif
+
+    for (; i < num; i++) {
+        if (id_array[i] == id) {
+            return i;
+        }
+    }
+
+    return UINT32_MAX;
+}
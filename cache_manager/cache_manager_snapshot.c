@@ -0,0 +1,323 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "cache_manager_snapshot.h"
+#include "cache_manager_config.h"
+#include <inttypes.h>
+#include <string.h>
+
+#define CM_SNAPSHOT_MAGIC 0x50534D43 /* "CMSP" */
+#define CM_SNAPSHOT_VERSION 1
+#define CM_SNAPSHOT_HEADER_SIZE 12
+#define CM_SNAPSHOT_RECORD_SIZE 16
+
+struct cache_manager_snapshot_s {
+    FILE* fp;
+    uint32_t num;
+    uint32_t mode;
+    uint32_t next;
+    uint32_t end;
+    bool started;
+    bool reverse;
+    bool done;
+};
+
+static void cm_snapshot_put_u32(uint8_t* buf, uint32_t value)
+{
+    buf[0] = (uint8_t)value;
+    buf[1] = (uint8_t)(value >> 8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t cm_snapshot_get_u32(const uint8_t* buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void cm_snapshot_encode(cache_manager_t* cm, uint8_t* buf, const cache_manager_node_t* node)
+{
+    /*Saved relative to the aging of the cache, like cm_restore() reads them*/
+    int32_t life = 0;
+    uint32_t ref_cnt = node->priv.ref_cnt;
+
+    if (cm->mode == CACHE_MANAGER_MODE_LIFE) {
+        life = (int32_t)((uint32_t)node->priv.life - cm->life_epoch);
+    } else if (cm->mode == CACHE_MANAGER_MODE_LFU) {
+        ref_cnt = cm->lfu_bucket_array[node->priv.pos].freq - cm->lfu_age;
+    }
+
+    cm_snapshot_put_u32(buf, (uint32_t)node->id);
+    cm_snapshot_put_u32(buf + 4, (uint32_t)life);
+    cm_snapshot_put_u32(buf + 8, ref_cnt);
+    cm_snapshot_put_u32(buf + 12, node->priv.time_to_open);
+}
+
+static void cm_snapshot_decode(const uint8_t* buf, cache_manager_node_t* node)
+{
+    memset(node, 0, sizeof(cache_manager_node_t));
+    node->id = (int)cm_snapshot_get_u32(buf);
+    node->priv.life = (int32_t)cm_snapshot_get_u32(buf + 4);
+    node->priv.ref_cnt = cm_snapshot_get_u32(buf + 8);
+    node->priv.time_to_open = cm_snapshot_get_u32(buf + 12);
+}
+
+cache_manager_res_t cm_snapshot_save(cache_manager_t* cm, const char* path)
+{
+    cache_manager_res_t res = CACHE_MANAGER_RES_ERR_UNKNOW;
+    size_t path_len = strlen(path);
+    char* tmp_path = NULL;
+    uint32_t* slot_array = NULL;
+    FILE* fp = NULL;
+
+    if (cm->key_table) {
+        /*Records only carry the id, keys are not saved*/
+        return CACHE_MANAGER_RES_ERR_MODE;
+    }
+
+    tmp_path = CACHE_MANAGER_MALLOC(path_len + sizeof(".tmp"));
+    slot_array = CACHE_MANAGER_MALLOC(sizeof(uint32_t) * cm->cache_num);
+
+    if (!tmp_path || !slot_array) {
+        CM_LOG_ERROR("snapshot malloc failed");
+        goto failed;
+    }
+
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+
+    fp = fopen(tmp_path, "wb");
+
+    if (!fp) {
+        CM_LOG_ERROR("can't create %s", tmp_path);
+        goto failed;
+    }
+
+    uint32_t num = cm_get_evict_order(cm, slot_array);
+    uint8_t buf[CM_SNAPSHOT_HEADER_SIZE];
+
+    cm_snapshot_put_u32(buf, CM_SNAPSHOT_MAGIC);
+    buf[4] = (uint8_t)CM_SNAPSHOT_VERSION;
+    buf[5] = (uint8_t)(CM_SNAPSHOT_VERSION >> 8);
+    buf[6] = (uint8_t)cm->mode;
+    buf[7] = 0;
+    cm_snapshot_put_u32(buf + 8, num);
+
+    if (fwrite(buf, CM_SNAPSHOT_HEADER_SIZE, 1, fp) != 1) {
+        goto write_failed;
+    }
+
+    /*The eviction order starts from the coldest, the file from the hottest*/
+    for (uint32_t i = num; i > 0; i--) {
+        cache_manager_node_t* node = &(cm->cache_node_array[slot_array[i - 1]]);
+        uint8_t record[CM_SNAPSHOT_RECORD_SIZE];
+
+        cm_snapshot_encode(cm, record, node);
+
+        if (fwrite(record, CM_SNAPSHOT_RECORD_SIZE, 1, fp) != 1) {
+            goto write_failed;
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        fp = NULL;
+        goto write_failed;
+    }
+    fp = NULL;
+
+    if (rename(tmp_path, path) != 0) {
+        CM_LOG_ERROR("can't rename %s to %s", tmp_path, path);
+        remove(tmp_path);
+        goto failed;
+    }
+
+    CM_LOG_INFO("snapshot of %" PRIu32 " nodes saved to %s", num, path);
+    res = CACHE_MANAGER_RES_OK;
+    goto failed;
+
+write_failed:
+    CM_LOG_ERROR("write %s failed", tmp_path);
+    if (fp) {
+        fclose(fp);
+        fp = NULL;
+    }
+    remove(tmp_path);
+
+failed:
+    if (fp) {
+        fclose(fp);
+    }
+    CACHE_MANAGER_FREE(slot_array);
+    CACHE_MANAGER_FREE(tmp_path);
+    return res;
+}
+
+cache_manager_snapshot_t* cm_snapshot_open(const char* path)
+{
+    cache_manager_snapshot_t* snapshot = NULL;
+    uint8_t buf[CM_SNAPSHOT_HEADER_SIZE];
+    FILE* fp = fopen(path, "rb");
+
+    if (!fp) {
+        CM_LOG_WARN("can't open %s", path);
+        return NULL;
+    }
+
+    if (fread(buf, CM_SNAPSHOT_HEADER_SIZE, 1, fp) != 1
+        || cm_snapshot_get_u32(buf) != CM_SNAPSHOT_MAGIC
+        || (buf[4] | (buf[5] << 8)) != CM_SNAPSHOT_VERSION
+        || buf[6] >= _CACHE_MANAGER_MODE_LAST) {
+        CM_LOG_WARN("%s is not a snapshot of this version", path);
+        goto failed;
+    }
+
+    uint32_t num = cm_snapshot_get_u32(buf + 8);
+
+    /*A truncated file would feed garbage ids to create_cb*/
+    if (fseek(fp, 0, SEEK_END) != 0 || ftell(fp) != (long)CM_SNAPSHOT_HEADER_SIZE + (long)num * CM_SNAPSHOT_RECORD_SIZE) {
+        CM_LOG_WARN("%s is truncated", path);
+        goto failed;
+    }
+
+    snapshot = CACHE_MANAGER_MALLOC(sizeof(cache_manager_snapshot_t));
+
+    if (!snapshot) {
+        CM_LOG_ERROR("snapshot malloc failed");
+        goto failed;
+    }
+
+    memset(snapshot, 0, sizeof(cache_manager_snapshot_t));
+    snapshot->fp = fp;
+    snapshot->num = num;
+    snapshot->mode = buf[6];
+    snapshot->done = (num == 0);
+    return snapshot;
+
+failed:
+    fclose(fp);
+    return NULL;
+}
+
+uint32_t cm_snapshot_get_num(cache_manager_snapshot_t* snapshot)
+{
+    return snapshot->num;
+}
+
+static void cm_snapshot_start(cache_manager_t* cm, cache_manager_snapshot_t* snapshot)
+{
+    snapshot->started = true;
+
+    if (cm->mode == CACHE_MANAGER_MODE_FIFO || cm->mode == CACHE_MANAGER_MODE_CLOCK) {
+        /*Rings keep the order slots are filled in, so the hottest entries
+         *that fit go in from the coldest of them*/
+        snapshot->reverse = true;
+        snapshot->next = (snapshot->num < cm->free_slot_cnt) ? snapshot->num : cm->free_slot_cnt;
+        snapshot->end = 0;
+        snapshot->done = (snapshot->next == 0);
+    } else {
+        snapshot->next = 0;
+        snapshot->end = snapshot->num;
+    }
+}
+
+static bool cm_snapshot_read(cache_manager_snapshot_t* snapshot, uint32_t index, cache_manager_node_t* node)
+{
+    uint8_t record[CM_SNAPSHOT_RECORD_SIZE];
+    long offset = (long)CM_SNAPSHOT_HEADER_SIZE + (long)index * CM_SNAPSHOT_RECORD_SIZE;
+
+    if (fseek(snapshot->fp, offset, SEEK_SET) != 0 || fread(record, CM_SNAPSHOT_RECORD_SIZE, 1, snapshot->fp) != 1) {
+        CM_LOG_ERROR("snapshot read failed");
+        return false;
+    }
+
+    cm_snapshot_decode(record, node);
+    return true;
+}
+
+uint32_t cm_snapshot_load_step(cache_manager_t* cm, cache_manager_snapshot_t* snapshot, uint32_t num)
+{
+    uint32_t restore_cnt = 0;
+
+    if (!snapshot->started) {
+        cm_snapshot_start(cm, snapshot);
+    }
+
+    while (!snapshot->done && num > 0) {
+        uint32_t index = snapshot->reverse ? --snapshot->next : snapshot->next++;
+        cache_manager_node_t node;
+
+        snapshot->done = (snapshot->next == snapshot->end);
+
+        if (!cm_snapshot_read(snapshot, index, &node)) {
+            snapshot->done = true;
+            break;
+        }
+
+        if (snapshot->mode != cm->mode) {
+            /*life only means something to the mode that aged it*/
+            node.priv.life = 0;
+        }
+
+        cache_manager_res_t res = cm_restore(cm, &node);
+
+        if (res == CACHE_MANAGER_RES_ERR_FULL || res == CACHE_MANAGER_RES_ERR_MODE) {
+            snapshot->done = true;
+            break;
+        }
+
+        /*Ids that fail to create are skipped, the rest is still worth loading*/
+        if (res == CACHE_MANAGER_RES_OK) {
+            restore_cnt++;
+        }
+
+        num--;
+    }
+
+    return restore_cnt;
+}
+
+bool cm_snapshot_is_done(cache_manager_snapshot_t* snapshot)
+{
+    return snapshot->done;
+}
+
+void cm_snapshot_close(cache_manager_snapshot_t* snapshot)
+{
+    fclose(snapshot->fp);
+    CACHE_MANAGER_FREE(snapshot);
+}
+
+uint32_t cm_snapshot_load(cache_manager_t* cm, const char* path)
+{
+    cache_manager_snapshot_t* snapshot = cm_snapshot_open(path);
+
+    if (!snapshot) {
+        return 0;
+    }
+
+    uint32_t restore_cnt = cm_snapshot_load_step(cm, snapshot, UINT32_MAX);
+    cm_snapshot_close(snapshot);
+    CM_LOG_INFO("%" PRIu32 " nodes restored from %s", restore_cnt, path);
+    return restore_cnt;
+}
@@ -0,0 +1,61 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CACHE_MANAGER_SNAPSHOT_H__
+#define __CACHE_MANAGER_SNAPSHOT_H__
+
+#include "cache_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cache_manager_snapshot_s cache_manager_snapshot_t;
+
+/* Snapshot file: a little endian header (magic, version, mode, count)
+ * followed by one record per resident node with its id, life, ref_cnt
+ * and time_to_open, the hottest first in the eviction order of the mode.
+ * The file is written next to path and renamed over it when complete. */
+cache_manager_res_t cm_snapshot_save(cache_manager_t* cm, const char* path);
+
+/* Incremental warm start: cm_snapshot_load_step() re-creates up to num
+ * entries through create_cb with cm_restore(), hottest first, so a host
+ * can spread the work over its idle time or run it from a loader thread
+ * under its own lock. FIFO and CLOCK fill their ring from the coldest of
+ * the entries that fit instead. Loading never evicts, it stops once the
+ * cache is full. Ids that fail to create are skipped. */
+cache_manager_snapshot_t* cm_snapshot_open(const char* path);
+uint32_t cm_snapshot_get_num(cache_manager_snapshot_t* snapshot);
+/* Returns how many entries were restored by this step */
+uint32_t cm_snapshot_load_step(cache_manager_t* cm, cache_manager_snapshot_t* snapshot, uint32_t num);
+bool cm_snapshot_is_done(cache_manager_snapshot_t* snapshot);
+void cm_snapshot_close(cache_manager_snapshot_t* snapshot);
+
+/* All in one go, returns how many entries were restored */
+uint32_t cm_snapshot_load(cache_manager_t* cm, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CACHE_MANAGER_SNAPSHOT_H__ */
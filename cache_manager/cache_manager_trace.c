@@ -0,0 +1,305 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "cache_manager_trace.h"
+#include "cache_manager_config.h"
+#include <inttypes.h>
+#include <string.h>
+
+#define CM_TRACE_MAGIC 0x52544D43 /* "CMTR" */
+#define CM_TRACE_VERSION 1
+#define CM_TRACE_HEADER_SIZE 12
+#define CM_TRACE_RECORD_SIZE 16
+
+struct cache_manager_trace_s {
+    cache_manager_trace_event_t* event_array;
+    uint32_t mask;
+    uint64_t head; /* events ever claimed */
+};
+
+static void cm_trace_put_u32(uint8_t* buf, uint32_t value)
+{
+    buf[0] = (uint8_t)value;
+    buf[1] = (uint8_t)(value >> 8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t cm_trace_get_u32(const uint8_t* buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+cache_manager_trace_t* cm_trace_create(uint32_t event_num)
+{
+    if (event_num == 0 || event_num > 0x80000000) {
+        return NULL;
+    }
+
+    uint32_t size = 1;
+    while (size < event_num) {
+        size <<= 1;
+    }
+
+    cache_manager_trace_t* trace = CACHE_MANAGER_MALLOC(sizeof(cache_manager_trace_t));
+
+    if (!trace) {
+        CM_LOG_ERROR("trace malloc failed");
+        return NULL;
+    }
+
+    trace->event_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_trace_event_t) * size);
+
+    if (!trace->event_array) {
+        CM_LOG_ERROR("trace event_array malloc failed");
+        CACHE_MANAGER_FREE(trace);
+        return NULL;
+    }
+
+    /*Sequence 0 never matches a position, the ring starts out empty*/
+    memset(trace->event_array, 0, sizeof(cache_manager_trace_event_t) * size);
+    trace->mask = size - 1;
+    trace->head = 0;
+    return trace;
+}
+
+void cm_trace_delete(cache_manager_trace_t* trace)
+{
+    CACHE_MANAGER_FREE(trace->event_array);
+    CACHE_MANAGER_FREE(trace);
+}
+
+void cm_set_trace(cache_manager_t* cm, cache_manager_trace_t* trace, uint16_t source)
+{
+#if CACHE_MANAGER_USE_TRACE
+    cm->trace = trace;
+    cm->trace_source = source;
+#else
+    CM_LOG_WARN("trace is disabled by CACHE_MANAGER_USE_TRACE");
+#endif
+}
+
+uint64_t cm_trace_get_cnt(cache_manager_trace_t* trace)
+{
+    return CM_ATOMIC_LOAD(&trace->head);
+}
+
+void cm_trace_record(cache_manager_trace_t* trace, cache_manager_trace_type_t type, uint16_t source, uint32_t tick, int id, uint32_t value)
+{
+    uint64_t pos = CM_ATOMIC_FETCH_ADD(&trace->head, 1);
+    cache_manager_trace_event_t* event = &trace->event_array[pos & trace->mask];
+    uint32_t seq = (uint32_t)pos + 1;
+
+    /*Seqlock style: mark the event as being written, fill it, publish it*/
+    CM_ATOMIC_STORE(&event->seq, seq - 1);
+    CM_ATOMIC_FENCE_RELEASE();
+    CM_ATOMIC_STORE(&event->tick, tick);
+    CM_ATOMIC_STORE(&event->id, (int32_t)id);
+    CM_ATOMIC_STORE(&event->value, value);
+    CM_ATOMIC_STORE(&event->type, (uint16_t)type);
+    CM_ATOMIC_STORE(&event->source, source);
+    CM_ATOMIC_STORE_RELEASE(&event->seq, seq);
+}
+
+static bool cm_trace_read_event(cache_manager_trace_t* trace, uint64_t pos, cache_manager_trace_event_t* dst)
+{
+    const cache_manager_trace_event_t* event = &trace->event_array[pos & trace->mask];
+    uint32_t seq = (uint32_t)pos + 1;
+
+    if (CM_ATOMIC_LOAD_ACQUIRE(&event->seq) != seq) {
+        return false;
+    }
+
+    dst->seq = seq;
+    dst->tick = CM_ATOMIC_LOAD(&event->tick);
+    dst->id = CM_ATOMIC_LOAD(&event->id);
+    dst->value = CM_ATOMIC_LOAD(&event->value);
+    dst->type = CM_ATOMIC_LOAD(&event->type);
+    dst->source = CM_ATOMIC_LOAD(&event->source);
+
+    /*A writer which lapped the ring meanwhile changed the sequence*/
+    CM_ATOMIC_FENCE_ACQUIRE();
+    return CM_ATOMIC_LOAD(&event->seq) == seq;
+}
+
+uint32_t cm_trace_read(cache_manager_trace_t* trace, uint64_t* cursor, cache_manager_trace_event_t* event_array, uint32_t num)
+{
+    uint64_t head = CM_ATOMIC_LOAD(&trace->head);
+    uint64_t size = (uint64_t)trace->mask + 1;
+    uint64_t pos = *cursor;
+    uint32_t cnt = 0;
+
+    if (head - pos > size || pos > head) {
+        pos = head > size ? head - size : 0;
+    }
+
+    for (; pos < head && cnt < num; pos++) {
+        if (cm_trace_read_event(trace, pos, &event_array[cnt])) {
+            cnt++;
+        }
+    }
+
+    *cursor = pos;
+    return cnt;
+}
+
+cache_manager_res_t cm_trace_save(cache_manager_trace_t* trace, const char* path)
+{
+    cache_manager_res_t res = CACHE_MANAGER_RES_ERR_UNKNOW;
+    uint32_t size = trace->mask + 1;
+    cache_manager_trace_event_t* event_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_trace_event_t) * size);
+    FILE* fp = NULL;
+
+    if (!event_array) {
+        CM_LOG_ERROR("trace save malloc failed");
+        goto failed;
+    }
+
+    uint64_t cursor = 0;
+    uint32_t num = cm_trace_read(trace, &cursor, event_array, size);
+
+    fp = fopen(path, "wb");
+
+    if (!fp) {
+        CM_LOG_ERROR("can't create %s", path);
+        goto failed;
+    }
+
+    uint8_t buf[CM_TRACE_HEADER_SIZE];
+
+    cm_trace_put_u32(buf, CM_TRACE_MAGIC);
+    cm_trace_put_u32(buf + 4, CM_TRACE_VERSION);
+    cm_trace_put_u32(buf + 8, num);
+
+    if (fwrite(buf, CM_TRACE_HEADER_SIZE, 1, fp) != 1) {
+        goto write_failed;
+    }
+
+    for (uint32_t i = 0; i < num; i++) {
+        const cache_manager_trace_event_t* event = &event_array[i];
+        uint8_t record[CM_TRACE_RECORD_SIZE];
+
+        cm_trace_put_u32(record, event->tick);
+        cm_trace_put_u32(record + 4, (uint32_t)event->id);
+        cm_trace_put_u32(record + 8, event->value);
+        cm_trace_put_u32(record + 12, (uint32_t)event->type | ((uint32_t)event->source << 16));
+
+        if (fwrite(record, CM_TRACE_RECORD_SIZE, 1, fp) != 1) {
+            goto write_failed;
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        fp = NULL;
+        goto write_failed;
+    }
+    fp = NULL;
+
+    CM_LOG_INFO("trace of %" PRIu32 " events saved to %s", num, path);
+    res = CACHE_MANAGER_RES_OK;
+    goto failed;
+
+write_failed:
+    CM_LOG_ERROR("write %s failed", path);
+
+failed:
+    if (fp) {
+        fclose(fp);
+    }
+    CACHE_MANAGER_FREE(event_array);
+    return res;
+}
+
+cache_manager_trace_event_t* cm_trace_load(const char* path, uint32_t* num)
+{
+    cache_manager_trace_event_t* event_array = NULL;
+    uint8_t buf[CM_TRACE_HEADER_SIZE];
+    FILE* fp = fopen(path, "rb");
+
+    if (!fp) {
+        CM_LOG_WARN("can't open %s", path);
+        return NULL;
+    }
+
+    if (fread(buf, CM_TRACE_HEADER_SIZE, 1, fp) != 1
+        || cm_trace_get_u32(buf) != CM_TRACE_MAGIC
+        || cm_trace_get_u32(buf + 4) != CM_TRACE_VERSION) {
+        CM_LOG_WARN("%s is not a trace of this version", path);
+        goto failed;
+    }
+
+    *num = cm_trace_get_u32(buf + 8);
+
+    /*One more slot, so that an empty trace isn't mistaken for a failure*/
+    event_array = CACHE_MANAGER_MALLOC(sizeof(cache_manager_trace_event_t) * ((size_t)*num + 1));
+
+    if (!event_array) {
+        CM_LOG_ERROR("trace load malloc failed");
+        goto failed;
+    }
+
+    for (uint32_t i = 0; i < *num; i++) {
+        cache_manager_trace_event_t* event = &event_array[i];
+        uint8_t record[CM_TRACE_RECORD_SIZE];
+
+        if (fread(record, CM_TRACE_RECORD_SIZE, 1, fp) != 1) {
+            CM_LOG_WARN("%s is truncated", path);
+            CACHE_MANAGER_FREE(event_array);
+            event_array = NULL;
+            goto failed;
+        }
+
+        event->seq = i + 1;
+        event->tick = cm_trace_get_u32(record);
+        event->id = (int32_t)cm_trace_get_u32(record + 4);
+        event->value = cm_trace_get_u32(record + 8);
+        event->type = (uint16_t)cm_trace_get_u32(record + 12);
+        event->source = (uint16_t)(cm_trace_get_u32(record + 12) >> 16);
+    }
+
+failed:
+    fclose(fp);
+    return event_array;
+}
+
+void cm_trace_free_events(cache_manager_trace_event_t* event_array)
+{
+    CACHE_MANAGER_FREE(event_array);
+}
+
+const char* cm_trace_get_type_name(cache_manager_trace_type_t type)
+{
+    static const char* name_array[] = {
+        "hit",
+        "miss",
+        "create",
+        "create_fail",
+        "l2_load",
+        "evict",
+        "invalidate",
+        "expire",
+    };
+
+    return type < _CACHE_MANAGER_TRACE_LAST ? name_array[type] : "unknown";
+}
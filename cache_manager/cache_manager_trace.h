@@ -0,0 +1,94 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CACHE_MANAGER_TRACE_H__
+#define __CACHE_MANAGER_TRACE_H__
+
+#include "cache_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cache_manager_trace_s cache_manager_trace_t;
+
+typedef enum cache_manager_trace_type_e {
+    CACHE_MANAGER_TRACE_HIT,
+    CACHE_MANAGER_TRACE_MISS,
+    CACHE_MANAGER_TRACE_CREATE, /* value: create_cb latency in ticks */
+    CACHE_MANAGER_TRACE_CREATE_FAIL,
+    CACHE_MANAGER_TRACE_L2_LOAD, /* value: load latency in ticks */
+    CACHE_MANAGER_TRACE_EVICT,
+    CACHE_MANAGER_TRACE_INVALIDATE,
+    CACHE_MANAGER_TRACE_EXPIRE,
+    _CACHE_MANAGER_TRACE_LAST
+} cache_manager_trace_type_t;
+
+typedef struct cache_manager_trace_event_s {
+    uint32_t seq; /* position in the ring + 1 once the event is complete */
+    uint32_t tick; /* tick_get_cb() of the cache, 0 without it */
+    int32_t id;
+    uint32_t value;
+    uint16_t type;
+    uint16_t source; /* set with cm_set_trace(), e.g. the shard index */
+} cache_manager_trace_event_t;
+
+/* Binary trace: caches record their accesses into a ring of fixed size
+ * events, the oldest ones are overwritten. Recording is lock-free and takes
+ * no lock of its own, so one trace can be shared by caches running on
+ * different threads, e.g. the shards of cache_manager_shard_t. Events are
+ * claimed with an atomic counter and published with a sequence number,
+ * cm_trace_read() skips the events that are still being written or were
+ * overwritten meanwhile. The trace is not owned by the caches, detach it
+ * from every cache before cm_trace_delete(). */
+cache_manager_trace_t* cm_trace_create(uint32_t event_num);
+void cm_trace_delete(cache_manager_trace_t* trace);
+/* NULL detaches. Needs CACHE_MANAGER_USE_TRACE. */
+void cm_set_trace(cache_manager_t* cm, cache_manager_trace_t* trace, uint16_t source);
+/* Number of events recorded since the creation of the trace */
+uint64_t cm_trace_get_cnt(cache_manager_trace_t* trace);
+/* Copies up to num events from *cursor on and moves the cursor past them.
+ * A cursor of 0 starts from the oldest event still in the ring, a cursor
+ * left behind by the writers jumps to it as well. Returns the number of
+ * events copied. */
+uint32_t cm_trace_read(cache_manager_trace_t* trace, uint64_t* cursor, cache_manager_trace_event_t* event_array, uint32_t num);
+
+/* Trace file: a little endian header (magic, version, count) followed by
+ * one 16 byte record per event (tick, id, value, type, source), the oldest
+ * first. cm_trace_save() dumps the events currently in the ring,
+ * cm_trace_load() reads a file back for offline decoding, see
+ * bench/trace_decode.c. Free the loaded events with cm_trace_free_events(). */
+cache_manager_res_t cm_trace_save(cache_manager_trace_t* trace, const char* path);
+cache_manager_trace_event_t* cm_trace_load(const char* path, uint32_t* num);
+void cm_trace_free_events(cache_manager_trace_event_t* event_array);
+
+const char* cm_trace_get_type_name(cache_manager_trace_type_t type);
+
+/* Called by the cache for every event when a trace is set */
+void cm_trace_record(cache_manager_trace_t* trace, cache_manager_trace_type_t type, uint16_t source, uint32_t tick, int id, uint32_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CACHE_MANAGER_TRACE_H__ */
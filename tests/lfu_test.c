@@ -0,0 +1,81 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* LFU evicts the least frequently used entry: in a 3 entry cache, ids
+ * opened 5, 1 and 3 times make room for a new id by dropping the one
+ * opened once. Run with `make test`. */
+
+#include "cache_manager/cache_manager.h"
+#include <stdio.h>
+
+static bool create_cb(cache_manager_node_t* node)
+{
+    node->context.size = 1;
+    return true;
+}
+
+static void open_times(cache_manager_t* cm, int id, int times)
+{
+    cache_manager_node_t* node;
+
+    for (int i = 0; i < times; i++) {
+        cm_open(cm, id, &node);
+    }
+}
+
+int main(void)
+{
+    int failed = 0;
+    cache_manager_t* cm = cm_create(3, CACHE_MANAGER_MODE_LFU, create_cb, NULL, NULL, NULL);
+
+    if (!cm) {
+        printf("FAIL: cm_create\n");
+        return 1;
+    }
+
+    open_times(cm, 1, 5);
+    open_times(cm, 2, 1);
+    open_times(cm, 3, 3);
+
+    /*The cache is full, the least frequently used entry makes room*/
+    open_times(cm, 4, 1);
+
+    if (cm_peek(cm, 2) != NULL) {
+        printf("FAIL: id 2 was opened once but is still resident\n");
+        failed = 1;
+    }
+
+    if (cm_peek(cm, 1) == NULL || cm_peek(cm, 3) == NULL || cm_peek(cm, 4) == NULL) {
+        printf("FAIL: a more frequently used entry was evicted\n");
+        failed = 1;
+    }
+
+    cm_delete(cm);
+
+    if (!failed) {
+        printf("lfu_test: OK\n");
+    }
+
+    return failed;
+}
@@ -0,0 +1,90 @@
+/*
+ * MIT License
+ * Copyright (c) 2022 _VIFEXTech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* cm_pool serves blocks from power-of-two classes, reuses freed blocks of
+ * the same class and falls through to the heap above max_block_size.
+ * Run with `make test`. */
+
+#include "cache_manager/cache_manager_pool.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL: %s:%d %s\n", __FILE__, __LINE__, #cond); \
+            failed = 1; \
+        } \
+    } while (0)
+
+int main(void)
+{
+    int failed = 0;
+    cache_manager_pool_t* pool = cm_pool_create(4096, 16 * 1024);
+
+    if (!pool) {
+        printf("FAIL: cm_pool_create\n");
+        return 1;
+    }
+
+    /*Rounded up to the size class*/
+    void* a = cm_pool_malloc(pool, 100);
+    CHECK(a != NULL);
+    CHECK(cm_pool_get_block_size(pool, a) == 128);
+    memset(a, 0xA5, 100);
+
+    /*A freed block is handed out again for the same class*/
+    cm_pool_free(pool, a);
+    void* b = cm_pool_malloc(pool, 120);
+    CHECK(b == a);
+
+    /*Blocks of one class don't overlap*/
+    void* c = cm_pool_malloc(pool, 128);
+    CHECK(c != NULL && c != b);
+    CHECK((char*)c >= (char*)b + 128 || (char*)b >= (char*)c + 128);
+
+    /*Larger than max_block_size: from the heap, with its exact size*/
+    void* large = cm_pool_malloc(pool, 100000);
+    CHECK(large != NULL);
+    CHECK(cm_pool_get_block_size(pool, large) == 100000);
+    memset(large, 0x5A, 100000);
+
+    /*A class larger than a slab still gets one block*/
+    void* big = cm_pool_malloc(pool, 4096);
+    CHECK(big != NULL);
+    CHECK(cm_pool_get_block_size(pool, big) == 4096);
+
+    cm_pool_free(pool, b);
+    cm_pool_free(pool, c);
+    cm_pool_free(pool, large);
+    cm_pool_free(pool, big);
+    cm_pool_free(pool, NULL);
+    cm_pool_delete(pool);
+
+    if (!failed) {
+        printf("pool_test: OK\n");
+    }
+
+    return failed;
+}